@@ -0,0 +1,229 @@
+#include "archive_format.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+#include "bit_stream.h"
+#include "exceptions.h"
+#include "huffman.h"
+#include "input_source.h"
+
+namespace {
+
+const std::size_t END_MARKER_SIZE = NAME_SIZE_BITS / CHAR_BIT;
+const std::size_t SCAN_CHUNK_SIZE = 1 << 16;
+
+// Returns the directory offset of the trailer that ends at archive_end, or nothing when there is no trailer there.
+std::optional<std::uint64_t> ReadTrailer(const RandomAccessFile& archive, std::uint64_t archive_end) {
+    if (archive_end < ARCHIVE_HEADER_SIZE + END_MARKER_SIZE + TRAILER_SIZE) {
+        return std::nullopt;
+    }
+    std::vector<std::uint8_t> trailer(TRAILER_SIZE);
+    archive.ReadAt(trailer, archive_end - TRAILER_SIZE);
+    MemorySource trailer_source(trailer);
+    BitReader trailer_input(trailer_source);
+    std::uint64_t directory_offset = trailer_input.ReadBits<std::uint64_t>(OFFSET_BITS);
+    if (!std::equal(DIRECTORY_MAGIC.begin(), DIRECTORY_MAGIC.end(), trailer.end() - DIRECTORY_MAGIC.size()) ||
+        directory_offset > archive_end - TRAILER_SIZE || directory_offset < ARCHIVE_HEADER_SIZE + END_MARKER_SIZE) {
+        return std::nullopt;
+    }
+    std::vector<std::uint8_t> end_marker(END_MARKER_SIZE);
+    archive.ReadAt(end_marker, directory_offset - end_marker.size());
+    if (std::any_of(end_marker.begin(), end_marker.end(), [](std::uint8_t byte) { return byte != 0; })) {
+        return std::nullopt;
+    }
+    return directory_offset;
+}
+
+ArchiveDirectory ReadArchiveDirectory(const RandomAccessFile& archive, std::uint64_t archive_end) {
+    std::optional<std::uint64_t> directory_offset = ReadTrailer(archive, archive_end);
+    if (!directory_offset) {
+        throw InvalidFormat();
+    }
+    std::vector<std::uint8_t> data(archive_end - TRAILER_SIZE - *directory_offset);
+    archive.ReadAt(data, *directory_offset);
+    MemorySource source(data);
+    BitReader input(source);
+    return ReadArchiveDirectory(input, *directory_offset);
+}
+
+// Looks for the last trailer before the end of the archive that is followed by the start of an unfinished append.
+std::uint64_t FindEarlierTrailer(const RandomAccessFile& archive) {
+    std::uint64_t archive_size = archive.Size();
+    std::vector<std::uint8_t> chunk;
+    for (std::uint64_t end = archive_size; end >= DIRECTORY_MAGIC.size();) {
+        std::uint64_t start = end - std::min<std::uint64_t>(end, SCAN_CHUNK_SIZE);
+        chunk.resize(end - start);
+        archive.ReadAt(chunk, start);
+        for (std::size_t i = chunk.size(); i >= DIRECTORY_MAGIC.size(); --i) {
+            std::uint64_t candidate = start + i;
+            if (candidate == archive_size ||
+                !std::equal(DIRECTORY_MAGIC.begin(), DIRECTORY_MAGIC.end(), chunk.begin() + static_cast<std::ptrdiff_t>(
+                                                                                    i - DIRECTORY_MAGIC.size()))) {
+                continue;
+            }
+            try {
+                ReadArchiveDirectory(archive, candidate);
+                return candidate;
+            } catch (const InvalidFormat& ex) {
+            }
+        }
+        if (start == 0) {
+            break;
+        }
+        end = start + DIRECTORY_MAGIC.size() - 1;
+    }
+    throw InvalidFormat();
+}
+
+}  // namespace
+
+ArchiveFormat DetectFormat(Path archive_name) {
+    std::ifstream is(archive_name, std::ios::binary);
+    std::array<char, ARCHIVE_MAGIC.size()> magic{};
+    is.read(magic.data(), magic.size());
+    if (is.gcount() == static_cast<std::streamsize>(magic.size()) &&
+        std::equal(magic.begin(), magic.end(), ARCHIVE_MAGIC.begin(),
+                   [](char lhs, std::uint8_t rhs) { return static_cast<std::uint8_t>(lhs) == rhs; })) {
+        return ArchiveFormat::Blocks;
+    }
+    return ArchiveFormat::Legacy;
+}
+
+std::size_t MaxPayloadSize(std::size_t raw_size) {
+    return (raw_size * MAX_CODE_SIZE + CHAR_BIT - 1) / CHAR_BIT + MAX_HEADER_SIZE;
+}
+
+void WriteArchiveHeader(BitWriter& output, const ArchiveHeader& header) {
+    output.WriteBytes(ARCHIVE_MAGIC);
+    output.WriteBits(ARCHIVE_VERSION, CHAR_BIT);
+    output.WriteBits(static_cast<std::uint8_t>(header.codec), CHAR_BIT);
+    output.WriteBits(header.dictionary_id, DICTIONARY_ID_BITS);
+}
+
+ArchiveHeader ReadArchiveHeader(BitReader& input) {
+    try {
+        std::array<std::uint8_t, ARCHIVE_MAGIC.size()> magic{};
+        input.ReadBytes(magic);
+        if (magic != ARCHIVE_MAGIC || input.ReadBits<std::uint8_t>(CHAR_BIT) != ARCHIVE_VERSION) {
+            throw InvalidFormat();
+        }
+        auto codec = input.ReadBits<std::uint8_t>(CHAR_BIT);
+        auto dictionary_id = input.ReadBits<std::uint32_t>(DICTIONARY_ID_BITS);
+        if (codec > static_cast<std::uint8_t>(CodecId::Lz77) ||
+            (dictionary_id != 0 && codec != static_cast<std::uint8_t>(CodecId::Huffman))) {
+            throw InvalidFormat();
+        }
+        return {static_cast<CodecId>(codec), dictionary_id};
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+}
+
+ArchiveHeader ReadArchiveHeader(const RandomAccessFile& archive) {
+    std::vector<std::uint8_t> header(ARCHIVE_HEADER_SIZE);
+    if (archive.Size() < header.size()) {
+        throw InvalidFormat();
+    }
+    archive.ReadAt(header, 0);
+    MemorySource source(header);
+    BitReader input(source);
+    return ReadArchiveHeader(input);
+}
+
+void WriteArchiveDirectory(BitWriter& output, const ArchiveDirectory& directory) {
+    output.Flush();
+    std::uint64_t directory_offset = output.Position() / CHAR_BIT;
+    output.WriteBits(directory.size(), COUNT_BITS);
+    for (const MemberEntry& member : directory) {
+        output.WriteBits(member.name.size(), NAME_SIZE_BITS);
+        output.WriteBytes({reinterpret_cast<const std::uint8_t*>(member.name.data()), member.name.size()});
+        output.WriteBits(member.header_offset, OFFSET_BITS);
+        output.WriteBits(member.compressed_size, OFFSET_BITS);
+        output.WriteBits(member.size, OFFSET_BITS);
+        output.WriteBits(member.checksum, CHECKSUM_BITS);
+        output.WriteBits(member.blocks.size(), COUNT_BITS);
+        for (const BlockEntry& block : member.blocks) {
+            output.WriteBits(block.payload_offset, OFFSET_BITS);
+            output.WriteBits(block.payload_size, BLOCK_SIZE_BITS);
+            output.WriteBits(block.raw_size | (block.shared_table ? SHARED_TABLE_FLAG : 0), BLOCK_SIZE_BITS);
+            output.WriteBits(block.output_offset, OFFSET_BITS);
+            output.WriteBits(block.checksum, CHECKSUM_BITS);
+        }
+    }
+    output.WriteBits(directory_offset, OFFSET_BITS);
+    output.WriteBytes(DIRECTORY_MAGIC);
+    output.Flush();
+}
+
+ArchiveDirectory ReadArchiveDirectory(BitReader& input, std::uint64_t directory_offset) {
+    auto read = [&](std::size_t bits) {
+        try {
+            return input.ReadBits<std::uint64_t>(bits);
+        } catch (const BitReader::EndOfFile& ex) {
+            throw InvalidFormat();
+        }
+    };
+    auto read_count = [&]() {
+        std::uint64_t count = read(COUNT_BITS);
+        if (count > directory_offset) {
+            throw InvalidFormat();
+        }
+        return count;
+    };
+
+    ArchiveDirectory directory(read_count());
+    for (MemberEntry& member : directory) {
+        member.name.resize(read(NAME_SIZE_BITS));
+        try {
+            input.ReadBytes({reinterpret_cast<std::uint8_t*>(member.name.data()), member.name.size()});
+        } catch (const BitReader::EndOfFile& ex) {
+            throw InvalidFormat();
+        }
+        member.header_offset = read(OFFSET_BITS);
+        member.compressed_size = read(OFFSET_BITS);
+        member.size = read(OFFSET_BITS);
+        member.checksum = read(CHECKSUM_BITS);
+        member.blocks.resize(read_count());
+        std::uint64_t expected_offset = 0;
+        for (BlockEntry& block : member.blocks) {
+            block.payload_offset = read(OFFSET_BITS);
+            block.payload_size = read(BLOCK_SIZE_BITS);
+            block.raw_size = read(BLOCK_SIZE_BITS);
+            block.shared_table = block.raw_size & SHARED_TABLE_FLAG;
+            block.raw_size &= ~SHARED_TABLE_FLAG;
+            block.output_offset = read(OFFSET_BITS);
+            block.checksum = read(CHECKSUM_BITS);
+            if (block.raw_size == 0 || block.raw_size > MAX_BLOCK_SIZE ||
+                block.payload_size > MaxPayloadSize(block.raw_size) || block.payload_offset > directory_offset ||
+                block.payload_size > directory_offset - block.payload_offset || block.output_offset != expected_offset) {
+                throw InvalidFormat();
+            }
+            expected_offset += block.raw_size;
+        }
+        if (member.name.empty() || member.header_offset > directory_offset ||
+            member.compressed_size > directory_offset - member.header_offset || expected_offset != member.size) {
+            throw InvalidFormat();
+        }
+    }
+    return directory;
+}
+
+std::uint64_t FindArchiveEnd(const RandomAccessFile& archive) {
+    if (ReadTrailer(archive, archive.Size())) {
+        return archive.Size();
+    }
+    return FindEarlierTrailer(archive);
+}
+
+ArchiveDirectory ReadArchiveDirectory(const RandomAccessFile& archive) {
+    return ReadArchiveDirectory(archive, FindArchiveEnd(archive));
+}
+
+AppendPoint ReadAppendPoint(const RandomAccessFile& archive) {
+    std::uint64_t archive_end = FindArchiveEnd(archive);
+    return {ReadArchiveHeader(archive), ReadArchiveDirectory(archive, archive_end), archive_end};
+}
@@ -1,60 +1,293 @@
 #include <algorithm>
+#include <charconv>
+#include <filesystem>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <optional>
 #include <random>
+#include <string>
 #include <string_view>
+#include <vector>
 
+#include "archive_format.h"
 #include "argument_parser.h"
 #include "compressor.h"
 #include "decompressor.h"
+#include "dictionary.h"
 #include "exceptions.h"
 #include "files.h"
+#include "huffman.h"
+#include "lz77.h"
+#include "stats.h"
+
+namespace {
+
+const std::vector<std::string> MODES = {"-c", "-a", "-d", "-t", "-x", "-l", "--train", "-h"};
+const std::vector<std::string> COMPRESS_OPTIONS = {"--block-size", "--max-code-length", "--codec", "--level",
+                                                "--window", "--adaptive", "--solid", "--dedup"};
+const std::map<std::string, CodecId> CODECS = {
+    {"huffman", CodecId::Huffman}, {"rans", CodecId::Rans}, {"lz77", CodecId::Lz77}};
+const std::map<std::string, StatsFormat> STATS_FORMATS = {{"text", StatsFormat::Text}, {"json", StatsFormat::Json}};
+const std::size_t MAX_THREADS_COUNT = 1 << 10;
+const std::size_t MIN_CODE_LENGTH = 9;
+const std::size_t MAX_CODE_LENGTH = MAX_CODE_SIZE;
+const std::size_t MIN_IO_CHUNK_SIZE = 1 << 12;
+const std::size_t MAX_IO_CHUNK_SIZE = 1 << 30;
+
+std::size_t ParseNumber(const ArgumentParser::ParsedArguments& arguments, const std::string& option,
+                        std::size_t min_value, std::size_t max_value) {
+    const std::string& value = arguments.values.at(option);
+    std::size_t number = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc() || end != value.data() + value.size() || number < min_value || number > max_value) {
+        throw ValidationError("Invalid value of option " + option);
+    }
+    return number;
+}
+
+Path ParseDictionaryName(const ArgumentParser::ParsedArguments& arguments) {
+    Path dictionary_name = arguments.values.at("--dict");
+    if (dictionary_name == STANDARD_STREAM || !ValidateInput(dictionary_name)) {
+        throw ValidationError("Invalid dictionary path");
+    }
+    return dictionary_name;
+}
+
+CompressOptions ParseCompressOptions(const ArgumentParser::ParsedArguments& arguments) {
+    CompressOptions options;
+    if (arguments.options.contains("-j")) {
+        options.format = ArchiveFormat::Blocks;
+        options.threads_count = ParseNumber(arguments, "-j", 1, MAX_THREADS_COUNT);
+    }
+    if (arguments.options.contains("--block-size")) {
+        options.format = ArchiveFormat::Blocks;
+        options.block_size = ParseNumber(arguments, "--block-size", 1, MAX_BLOCK_SIZE);
+    }
+    if (arguments.options.contains("--codec")) {
+        auto codec = CODECS.find(arguments.values.at("--codec"));
+        if (codec == CODECS.end()) {
+            throw ValidationError("Invalid value of option --codec");
+        }
+        options.format = ArchiveFormat::Blocks;
+        options.codec = codec->second;
+    }
+    if (arguments.options.contains("--level") || arguments.options.contains("--window")) {
+        if (arguments.options.contains("--codec") && options.codec != CodecId::Lz77) {
+            throw ValidationError("Options --level and --window are only valid for lz77 codec");
+        }
+        options.format = ArchiveFormat::Blocks;
+        options.codec = CodecId::Lz77;
+    }
+    if (arguments.options.contains("--level")) {
+        options.level = ParseNumber(arguments, "--level", MIN_LEVEL, MAX_LEVEL);
+    }
+    if (arguments.options.contains("--window")) {
+        options.window_bits = ParseNumber(arguments, "--window", MIN_WINDOW_BITS, MAX_WINDOW_BITS);
+    }
+    if (arguments.options.contains("--adaptive")) {
+        if (options.codec != CodecId::Huffman) {
+            throw ValidationError("Option --adaptive is only valid for huffman codec");
+        }
+        options.format = ArchiveFormat::Blocks;
+        options.adaptive = true;
+    }
+    if (arguments.options.contains("--solid")) {
+        options.format = ArchiveFormat::Blocks;
+        options.solid = true;
+    }
+    if (arguments.options.contains("--dedup")) {
+        options.format = ArchiveFormat::Blocks;
+        options.dedup = true;
+    }
+    if (arguments.options.contains("--max-code-length")) {
+        options.max_code_size = ParseNumber(arguments, "--max-code-length", MIN_CODE_LENGTH, MAX_CODE_LENGTH);
+    }
+    if (arguments.options.contains("--io-chunk")) {
+        options.io_chunk_size = ParseNumber(arguments, "--io-chunk", MIN_IO_CHUNK_SIZE, MAX_IO_CHUNK_SIZE);
+    }
+    if (arguments.options.contains("--dict")) {
+        if (options.codec != CodecId::Huffman) {
+            throw ValidationError("Option --dict is only valid for huffman codec");
+        }
+        options.format = ArchiveFormat::Blocks;
+        options.dictionary = ParseDictionaryName(arguments);
+    }
+    return options;
+}
+
+DecompressOptions ParseDecompressOptions(const ArgumentParser::ParsedArguments& arguments) {
+    if (std::any_of(COMPRESS_OPTIONS.begin(), COMPRESS_OPTIONS.end(),
+                    [&](const std::string& option) { return arguments.options.contains(option); })) {
+        throw ValidationError("Encoding options are only valid for compression");
+    }
+    DecompressOptions options;
+    if (arguments.options.contains("-j")) {
+        options.threads_count = ParseNumber(arguments, "-j", 1, MAX_THREADS_COUNT);
+    }
+    if (arguments.options.contains("--io-chunk")) {
+        options.io_chunk_size = ParseNumber(arguments, "--io-chunk", MIN_IO_CHUNK_SIZE, MAX_IO_CHUNK_SIZE);
+    }
+    if (arguments.options.contains("--dict")) {
+        options.dictionary = ParseDictionaryName(arguments);
+    }
+    return options;
+}
+
+std::optional<StatsFormat> ParseStatsFormat(const ArgumentParser::ParsedArguments& arguments) {
+    if (!arguments.options.contains("--stats")) {
+        return std::nullopt;
+    }
+    if (!STATS_ENABLED) {
+        throw ValidationError("Option --stats is not available in this build");
+    }
+    auto format = STATS_FORMATS.find(arguments.values.at("--stats"));
+    if (format == STATS_FORMATS.end()) {
+        throw ValidationError("Invalid value of option --stats");
+    }
+    return format->second;
+}
+
+Path ParseArchiveName(const ArgumentParser::ParsedArguments& arguments) {
+    if (arguments.positional_arguments.empty()) {
+        throw ValidationError("You need to specify archive name");
+    }
+    Path archive_name = arguments.positional_arguments[0];
+    if (archive_name == STANDARD_STREAM || !ValidateInput(archive_name)) {
+        throw ValidationError("Invalid archive path");
+    }
+    return archive_name;
+}
+
+}  // namespace
 
 int main(int argc, char** argv) {
     ArgumentParser parser("archiver");
-    parser.AddOption("-c", "compress files into archive", "-c archive_name file1 [file2 ...]");
+    parser.AddOption("-c", "compress files and directories into archive, - reads standard input",
+                     "-c archive_name file1 [file2 ...]");
+    parser.AddOption("-a", "add files and directories to a block archive, a name added again replaces the earlier one",
+                     "-a archive_name file1 [file2 ...]");
     parser.AddOption("-d", "decompress archive", "-d archive_name");
+    parser.AddOption("-t", "check that archive decodes and matches its checksums without writing files",
+                     "-t archive_name");
+    parser.AddOption("-x", "extract selected files (block archive format)", "-x archive_name file1 [file2 ...]");
+    parser.AddOption("-l", "list archived files (block archive format)", "-l archive_name");
+    parser.AddOption("--train", "build a dictionary from sample files for archives of small files",
+                     "--train dictionary_name file1 [file2 ...]");
     parser.AddOption("-h", "show this message", "-h");
+    parser.AddOption("-j", "process blocks on N threads (block archive format)", "-j N", true);
+    parser.AddOption("--block-size", "block size in bytes (block archive format)", "--block-size BYTES", true);
+    parser.AddOption("--codec", "block coder: huffman, rans or lz77 (block archive format)", "--codec NAME", true);
+    parser.AddOption("--level", "lz77 match search effort from 1 to 9", "--level N", true);
+    parser.AddOption("--window", "lz77 window of 2^BITS bytes (10 to 24)", "--window BITS", true);
+    parser.AddOption("--adaptive", "start a new code table where statistics change (block archive format)",
+                     "--adaptive");
+    parser.AddOption("--solid", "code small files with one table per group (block archive format)", "--solid");
+    parser.AddOption("--dedup", "store repeated chunks of files once (block archive format)", "--dedup");
+    parser.AddOption("--max-code-length", "limit Huffman code lengths to N bits (9 to 56)",
+                     "--max-code-length N", true);
+    parser.AddOption("--dict", "code blocks with a trained dictionary (block archive format)", "--dict FILE", true);
+    parser.AddOption("--io-chunk", "read and write files in chunks of BYTES on separate threads", "--io-chunk BYTES",
+                     true);
+    parser.AddOption("--stdout", "write decompressed files to standard output", "--stdout");
+    parser.AddOption("--stats", "print counters and stage timings to standard error as text or json",
+                     "--stats FORMAT", true);
+
+    std::ios::sync_with_stdio(false);
 
+    Stats stats;
+    std::optional<StatsFormat> stats_format;
     try {
         auto parsed_arguments = parser.ParseArguments(argc, argv);
+        auto modes_count = std::count_if(MODES.begin(), MODES.end(), [&](const std::string& mode) {
+            return parsed_arguments.options.contains(mode);
+        });
 
-        if (parsed_arguments.options.size() > 1) {
+        if (modes_count > 1) {
             throw ValidationError("Too many options");
-        } else if (parsed_arguments.options.empty()) {
+        } else if (modes_count == 0) {
             throw ValidationError("You need to specify at least one option");
+        } else if (parsed_arguments.options.contains("--stdout") && !parsed_arguments.options.contains("-d")) {
+            throw ValidationError("Option --stdout is only valid for decompression");
         } else if (parsed_arguments.options.contains("-h")) {
             parser.PrintUsage();
             return 0;
-        } else if (parsed_arguments.options.contains("-c")) {
+        }
+
+        stats_format = ParseStatsFormat(parsed_arguments);
+        Stats* stats_pointer = stats_format ? &stats : nullptr;
+        StageTimer timer(stats_pointer, Stage::Total);
+        if (parsed_arguments.options.contains("-c") || parsed_arguments.options.contains("-a")) {
             if (parsed_arguments.positional_arguments.size() < 2) {
                 throw ValidationError("You need to specify archive name and at least one input file");
             }
+            CompressOptions options = ParseCompressOptions(parsed_arguments);
+            options.stats = stats_pointer;
             Path archive_name = parsed_arguments.positional_arguments[0];
-            if (!ValidateOutput(archive_name)) {
+            if (archive_name == STANDARD_STREAM || !ValidateOutput(archive_name)) {
                 throw ValidationError("Archive destination is not valid");
             }
             std::vector<Path> filenames;
             for (std::size_t i = 1; i < parsed_arguments.positional_arguments.size(); ++i) {
                 Path filename = parsed_arguments.positional_arguments[i];
-                if (!ValidateInput(filename)) {
+                if (!ValidateInput(filename) && !std::filesystem::is_directory(filename)) {
                     throw ValidationError("At least one of input files is not valid");
                 }
                 filenames.push_back(filename);
             }
-            Compress(archive_name, filenames);
+            if (parsed_arguments.options.contains("-a")) {
+                Append(archive_name, filenames, options);
+            } else {
+                Compress(archive_name, filenames, options);
+            }
         } else if (parsed_arguments.options.contains("-d")) {
-            if (parsed_arguments.positional_arguments.empty()) {
-                throw ValidationError("You need to specify archive name");
-            } else if (parsed_arguments.positional_arguments.size() > 1) {
+            DecompressOptions options = ParseDecompressOptions(parsed_arguments);
+            options.stats = stats_pointer;
+            options.standard_output = parsed_arguments.options.contains("--stdout");
+            if (parsed_arguments.positional_arguments.size() > 1) {
                 throw ValidationError("Too many positional arguments");
             }
-            Path archive_name = parsed_arguments.positional_arguments[0];
-            if (!ValidateInput(archive_name)) {
-                throw ValidationError("Invalid archive path");
+            Decompress(ParseArchiveName(parsed_arguments), options);
+        } else if (parsed_arguments.options.contains("-t")) {
+            DecompressOptions options = ParseDecompressOptions(parsed_arguments);
+            options.stats = stats_pointer;
+            if (parsed_arguments.positional_arguments.size() > 1) {
+                throw ValidationError("Too many positional arguments");
+            }
+            Test(ParseArchiveName(parsed_arguments), options);
+        } else if (parsed_arguments.options.contains("-x")) {
+            DecompressOptions options = ParseDecompressOptions(parsed_arguments);
+            options.stats = stats_pointer;
+            if (parsed_arguments.positional_arguments.size() < 2) {
+                throw ValidationError("You need to specify archive name and at least one file to extract");
             }
-            Decompress(archive_name);
+            std::vector<std::string> names(parsed_arguments.positional_arguments.begin() + 1,
+                                           parsed_arguments.positional_arguments.end());
+            Extract(ParseArchiveName(parsed_arguments), names, options);
+        } else if (parsed_arguments.options.contains("-l")) {
+            ParseDecompressOptions(parsed_arguments);
+            if (parsed_arguments.positional_arguments.size() > 1) {
+                throw ValidationError("Too many positional arguments");
+            }
+            List(ParseArchiveName(parsed_arguments), std::cout);
+        } else if (parsed_arguments.options.contains("--train")) {
+            if (parsed_arguments.positional_arguments.size() < 2) {
+                throw ValidationError("You need to specify dictionary name and at least one sample file");
+            }
+            Path dictionary_name = parsed_arguments.positional_arguments[0];
+            if (dictionary_name == STANDARD_STREAM || !ValidateOutput(dictionary_name)) {
+                throw ValidationError("Dictionary destination is not valid");
+            }
+            std::vector<Path> samples;
+            for (std::size_t i = 1; i < parsed_arguments.positional_arguments.size(); ++i) {
+                Path sample = parsed_arguments.positional_arguments[i];
+                if (sample == STANDARD_STREAM || !ValidateInput(sample)) {
+                    throw ValidationError("At least one of sample files is not valid");
+                }
+                samples.push_back(sample);
+            }
+            SaveDictionary(dictionary_name, TrainDictionary(samples));
         }
     } catch (const ParsingError& exc) {
         std::cerr << "ERROR: " << exc.what() << "\n\n";
@@ -65,5 +298,8 @@ int main(int argc, char** argv) {
         return 111;
     }
 
+    if (stats_format) {
+        PrintStats(std::cerr, stats, *stats_format);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -7,18 +7,19 @@
 
 ArgumentParser::OptionData::OptionData() = default;
 
-ArgumentParser::OptionData::OptionData(std::string_view description, std::string_view usage)
-    : description(description), usage(usage) {
+ArgumentParser::OptionData::OptionData(std::string_view description, std::string_view usage, bool has_value)
+    : description(description), usage(usage), has_value(has_value) {
 }
 
 ArgumentParser::ArgumentParser(std::string_view program_name) : program_name_(program_name) {
 }
 
-void ArgumentParser::AddOption(std::string_view name, std::string_view description, std::string_view usage) noexcept {
+void ArgumentParser::AddOption(std::string_view name, std::string_view description, std::string_view usage,
+                               bool has_value) noexcept {
     if (options_.contains(name.data())) {
         return;
     }
-    options_[name.data()] = OptionData(description, usage);
+    options_[name.data()] = OptionData(description, usage, has_value);
     ordered_options_.push_back(std::string(name));
 }
 
@@ -27,7 +28,7 @@ ArgumentParser::ParsedArguments ArgumentParser::ParseArguments(int, char **argv)
     ++argv;
     while (*argv) {
         std::string_view argument = *argv;
-        if (argument.starts_with('-')) {
+        if (argument.starts_with('-') && argument.size() > 1) {
             if (!parsed_arguments.positional_arguments.empty()) {
                 throw ParsingError("Found option after positional argument");
             }
@@ -38,6 +39,13 @@ ArgumentParser::ParsedArguments ArgumentParser::ParseArguments(int, char **argv)
                 throw ParsingError("Option is specified multiple times");
             }
             parsed_arguments.options.insert(std::string(argument));
+            if (options_.at(argument.data()).has_value) {
+                ++argv;
+                if (!*argv) {
+                    throw ParsingError("Option requires a value");
+                }
+                parsed_arguments.values[std::string(argument)] = *argv;
+            }
         } else {
             parsed_arguments.positional_arguments.push_back(std::string(argument));
         }
@@ -53,7 +61,7 @@ void ArgumentParser::PrintUsage() const noexcept {
     std::cerr << "[<argument> ...]\n\n";
     std::cerr << "OPTIONS:\n";
     for (const auto &name : ordered_options_) {
-        const auto &[description, usage] = options_.at(name);
+        const auto &[description, usage, has_value] = options_.at(name);
         std::cerr << "\t" << '`' << usage << '`' << "  --  " << description << '\n';
     }
 }
@@ -0,0 +1,569 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "archive_format.h"
+#include "argument_parser.h"
+#include "binary_trie.h"
+#include "bit_stream.h"
+#include "block_codec.h"
+#include "checksum.h"
+#include "compressor.h"
+#include "decode_table.h"
+#include "decompressor.h"
+#include "exceptions.h"
+#include "files.h"
+#include "huffman.h"
+#include "input_source.h"
+#include "output_sink.h"
+
+namespace {
+
+const std::size_t MEGABYTE = 1 << 20;
+const std::size_t DEFAULT_INPUT_MEGABYTES = 16;
+const std::size_t MAX_INPUT_MEGABYTES = 1 << 12;
+const std::size_t DEFAULT_REPEATS = 3;
+const std::size_t MAX_REPEATS = 100;
+const double DEFAULT_TOLERANCE = 10;
+const std::size_t TABLE_REPEATS = 1000;
+const std::size_t SMALL_FILES_COUNT = 2000;
+const std::size_t MIN_SMALL_FILE_SIZE = 256;
+const std::size_t MAX_SMALL_FILE_SIZE = 4096;
+const std::size_t HUGE_FILE_FACTOR = 8;
+const std::size_t VOCABULARY_SIZE = 4000;
+const std::size_t MAX_BIT_WIDTH = 16;
+
+const std::vector<std::string> CORPORA = {"random", "skewed", "text", "small", "huge"};
+
+// ns/symbol is per input byte for coding stages, per alphabet symbol for table stages and per call for bit streams.
+struct Result {
+    std::string name;
+    double megabytes_per_second = 0;
+    double nanoseconds_per_symbol = 0;
+    double ratio = 0;
+    double peak_megabytes = 0;
+};
+
+void ResetPeakMemory() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+// Falls back to the peak of the whole process when the kernel does not report VmHWM.
+double PeakMemory() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);) {
+        if (line.starts_with("VmHWM:")) {
+            return std::stod(line.substr(line.find_first_not_of(' ', 6))) / 1024;
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024;
+}
+
+class Bench {
+public:
+    explicit Bench(std::size_t repeats) : repeats_(repeats) {
+    }
+
+    // Runs the action repeats times and keeps the fastest run. Zero bytes means throughput does not apply.
+    void Run(std::string_view corpus, std::string_view stage, std::size_t bytes, std::size_t symbols,
+             const std::function<void()>& action, const std::function<double()>& ratio = {}) {
+        double seconds = std::numeric_limits<double>::max();
+        ResetPeakMemory();
+        for (std::size_t i = 0; i < repeats_; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            action();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds = std::min(seconds, elapsed.count());
+        }
+        Result& result = results_.emplace_back();
+        result.name = std::string(corpus) + "/" + std::string(stage);
+        result.megabytes_per_second = bytes == 0 ? 0 : static_cast<double>(bytes) / MEGABYTE / seconds;
+        result.nanoseconds_per_symbol = seconds * 1e9 / static_cast<double>(std::max<std::size_t>(symbols, 1));
+        result.ratio = ratio ? ratio() : 0;
+        result.peak_megabytes = PeakMemory();
+        Print(result);
+    }
+
+    const std::vector<Result>& Results() const {
+        return results_;
+    }
+
+    static void PrintHeader() {
+        std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(12) << "MB/s"
+                  << std::setw(12) << "ns/symbol" << std::setw(8) << "ratio" << std::setw(12) << "peak MiB" << '\n';
+    }
+
+private:
+    std::size_t repeats_;
+    std::vector<Result> results_;
+
+    static void PrintValue(double value, std::size_t width, std::size_t precision) {
+        if (value == 0) {
+            std::cout << std::setw(static_cast<int>(width)) << "-";
+        } else {
+            std::cout << std::setw(static_cast<int>(width)) << std::setprecision(static_cast<int>(precision)) << value;
+        }
+    }
+
+    static void Print(const Result& result) {
+        std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed;
+        PrintValue(result.megabytes_per_second, 12, 1);
+        PrintValue(result.nanoseconds_per_symbol, 12, 2);
+        PrintValue(result.ratio, 8, 3);
+        PrintValue(result.peak_megabytes, 12, 1);
+        std::cout << std::endl;
+    }
+};
+
+std::vector<std::uint8_t> GenerateRandom(std::size_t size, std::mt19937& generator) {
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<std::uint8_t> data(size);
+    for (std::uint8_t& c : data) {
+        c = static_cast<std::uint8_t>(distribution(generator));
+    }
+    return data;
+}
+
+std::vector<std::uint8_t> GenerateSkewed(std::size_t size, std::mt19937& generator) {
+    std::geometric_distribution<int> distribution(0.08);
+    std::vector<std::uint8_t> data(size);
+    for (std::uint8_t& c : data) {
+        c = static_cast<std::uint8_t>('a' + distribution(generator) % 64);
+    }
+    return data;
+}
+
+// Words with Zipf-like frequencies, separated by spaces, punctuation and line breaks.
+class TextGenerator {
+public:
+    explicit TextGenerator(std::uint32_t seed) : generator_(seed) {
+        std::uniform_int_distribution<int> length(2, 10);
+        std::uniform_int_distribution<int> letter('a', 'z');
+        std::vector<double> weights;
+        for (std::size_t i = 0; i < VOCABULARY_SIZE; ++i) {
+            std::string& word = words_.emplace_back(length(generator_), ' ');
+            std::generate(word.begin(), word.end(), [&] { return static_cast<char>(letter(generator_)); });
+            weights.push_back(1.0 / static_cast<double>(i + 1));
+        }
+        word_ = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+    }
+
+    std::vector<std::uint8_t> Generate(std::size_t size) {
+        static const std::string_view SEPARATORS = "     ,.\n";
+        std::uniform_int_distribution<std::size_t> separator(0, SEPARATORS.size() - 1);
+        std::vector<std::uint8_t> data;
+        data.reserve(size + 16);
+        while (data.size() < size) {
+            const std::string& word = words_[word_(generator_)];
+            data.insert(data.end(), word.begin(), word.end());
+            data.push_back(static_cast<std::uint8_t>(SEPARATORS[separator(generator_)]));
+        }
+        data.resize(size);
+        return data;
+    }
+
+private:
+    std::mt19937 generator_;
+    std::vector<std::string> words_;
+    std::discrete_distribution<std::size_t> word_;
+};
+
+double Ratio(std::size_t raw_size, std::size_t compressed_size) {
+    return static_cast<double>(raw_size) / static_cast<double>(std::max<std::size_t>(compressed_size, 1));
+}
+
+void WriteFile(Path filename, std::span<const std::uint8_t> data) {
+    std::ofstream os(filename, std::ios::binary);
+    os.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+void BenchStages(Bench& bench, std::string_view corpus, const std::vector<std::uint8_t>& data) {
+    SymbolsCount symbols_count{};
+    bench.Run(corpus, "histogram", data.size(), data.size(), [&] {
+        symbols_count.fill(0);
+        CountBytes(data, symbols_count);
+    });
+    std::uint32_t checksum = 0;
+    bench.Run(corpus, "checksum", data.size(), data.size(), [&] { checksum ^= Crc32c(data); });
+
+    CodeSizes sizes;
+    std::size_t table_symbols = TABLE_REPEATS * ALPHABET_SIZE;
+    bench.Run(corpus, "tree build (trie)", 0, table_symbols, [&] {
+        for (std::size_t i = 0; i < TABLE_REPEATS; ++i) {
+            sizes = TreeHuffmanEncoding(symbols_count);
+        }
+    });
+    bench.Run(corpus, "tree build (linear)", 0, table_symbols, [&] {
+        for (std::size_t i = 0; i < TABLE_REPEATS; ++i) {
+            sizes = HuffmanEncoding(symbols_count);
+        }
+    });
+    bench.Run(corpus, "length limit", 0, table_symbols, [&] {
+        for (std::size_t i = 0; i < TABLE_REPEATS; ++i) {
+            sizes = LimitedHuffmanEncoding(symbols_count, MAX_CODE_SIZE);
+        }
+    });
+    CodeTable codes{};
+    bench.Run(corpus, "canonical codes", 0, table_symbols, [&] {
+        for (std::size_t i = 0; i < TABLE_REPEATS; ++i) {
+            codes = CanonicalCodes(sizes);
+        }
+    });
+
+    std::vector<std::uint8_t> encoded;
+    bench.Run(
+        corpus, "encode", data.size(), data.size(),
+        [&] {
+            encoded.clear();
+            MemorySink sink(encoded);
+            BitWriter output(sink);
+            EncodeBuffer(output, codes, data);
+            output.Flush();
+        },
+        [&] { return Ratio(data.size(), encoded.size()); });
+
+    std::vector<std::uint8_t> decoded(data.size());
+    BinaryTrie trie;
+    for (std::size_t key = 0; key < codes.size(); ++key) {
+        if (codes[key].size > 0) {
+            trie.AddCode(codes[key].code, codes[key].size, static_cast<Char>(key));
+        }
+    }
+    bench.Run(corpus, "decode (trie)", data.size(), data.size(), [&] {
+        MemorySource source(encoded);
+        BitReader input(source);
+        for (std::uint8_t& c : decoded) {
+            BinaryTrie::Index node = trie.Root();
+            while (!trie[node].IsTerminal()) {
+                node = trie.Child(node, input.ReadBit());
+            }
+            c = static_cast<std::uint8_t>(trie[node].key);
+        }
+    });
+    DecodeTable table(codes);
+    bench.Run(corpus, "decode (table)", data.size(), data.size(), [&] {
+        MemorySource source(encoded);
+        BitReader input(source);
+        for (std::uint8_t& c : decoded) {
+            c = static_cast<std::uint8_t>(table.Decode(input));
+        }
+    });
+    if (decoded != data) {
+        throw InvalidFormat();
+    }
+
+    std::vector<std::uint8_t> bits;
+    auto width = [](std::size_t i) { return 1 + i % MAX_BIT_WIDTH; };
+    bench.Run(
+        corpus, "bit write", data.size() * (MAX_BIT_WIDTH + 1) / 2 / CHAR_BIT, data.size(), [&] {
+            bits.clear();
+            MemorySink sink(bits);
+            BitWriter output(sink);
+            for (std::size_t i = 0; i < data.size(); ++i) {
+                output.WriteBits(data[i] & ((1u << width(i)) - 1), width(i));
+            }
+            output.Flush();
+        });
+    bench.Run(corpus, "bit read", data.size() * (MAX_BIT_WIDTH + 1) / 2 / CHAR_BIT, data.size(), [&] {
+        MemorySource source(bits);
+        BitReader input(source);
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            if (input.ReadBits<std::uint8_t>(width(i)) != (data[i] & ((1u << width(i)) - 1))) {
+                throw InvalidFormat();
+            }
+        }
+    });
+
+    for (const auto& [name, codec_id] : {std::pair{"huffman", CodecId::Huffman}, std::pair{"rans", CodecId::Rans},
+                                         std::pair{"lz77", CodecId::Lz77}}) {
+        auto codec = CreateCodec(codec_id);
+        std::vector<EncodedBlock> blocks;
+        std::size_t payload_size = 0;
+        bench.Run(
+            corpus, std::string("codec encode (") + name + ")", data.size(), data.size(),
+            [&] {
+                blocks.clear();
+                payload_size = 0;
+                for (std::size_t offset = 0; offset < data.size(); offset += DEFAULT_BLOCK_SIZE) {
+                    auto block = std::span(data).subspan(offset, std::min(DEFAULT_BLOCK_SIZE, data.size() - offset));
+                    payload_size += blocks.emplace_back(codec->Encode(block)).payload.size();
+                }
+            },
+            [&] { return Ratio(data.size(), payload_size); });
+        bench.Run(corpus, std::string("codec decode (") + name + ")", data.size(), data.size(), [&] {
+            std::size_t offset = 0;
+            for (const EncodedBlock& block : blocks) {
+                codec->Decode(block.payload, std::span(decoded).subspan(offset, block.raw_size));
+                offset += block.raw_size;
+            }
+        });
+        if (decoded != data) {
+            throw InvalidFormat();
+        }
+    }
+}
+
+void BenchFiles(Bench& bench, std::string_view corpus, const std::vector<Path>& files, Path directory,
+                std::size_t threads_count) {
+    std::size_t total_size = 0;
+    for (const Path& file : files) {
+        total_size += std::filesystem::file_size(file);
+    }
+    Path archive = directory / "archive.arc";
+    Path output = directory / "output";
+    std::filesystem::create_directories(output);
+    auto ratio = [&] { return Ratio(total_size, std::filesystem::file_size(archive)); };
+    auto compress = [&](std::string_view stage, const CompressOptions& options) {
+        bench.Run(corpus, stage, total_size, total_size, [&] { Compress(archive, files, options); }, ratio);
+    };
+    auto decompress = [&](std::string_view stage, const DecompressOptions& options) {
+        std::filesystem::current_path(output);
+        bench.Run(corpus, stage, total_size, total_size, [&] { Decompress(archive, options); });
+        std::filesystem::current_path(directory);
+    };
+    auto test = [&](std::string_view stage, const DecompressOptions& options) {
+        bench.Run(corpus, stage, total_size, total_size, [&] { Test(archive, options); });
+    };
+    std::string threads = " -j " + std::to_string(threads_count);
+
+    compress("compress (legacy)", {});
+    DecompressOptions trie;
+    trie.decoder = DecoderType::Trie;
+    decompress("decompress (legacy, trie)", trie);
+    decompress("decompress (legacy, table)", {});
+
+    CompressOptions blocks;
+    blocks.format = ArchiveFormat::Blocks;
+    compress("compress (blocks)", blocks);
+    decompress("decompress (blocks)", {});
+    blocks.threads_count = threads_count;
+    DecompressOptions parallel;
+    parallel.threads_count = threads_count;
+    if (threads_count > 1) {
+        compress("compress (blocks" + threads + ")", blocks);
+        decompress("decompress (blocks" + threads + ")", parallel);
+    }
+    test("test (blocks)", {});
+    if (threads_count > 1) {
+        test("test (blocks" + threads + ")", parallel);
+    }
+    blocks.dedup = true;
+    compress("compress (dedup" + threads + ")", blocks);
+    decompress("decompress (dedup" + threads + ")", parallel);
+    blocks.dedup = false;
+    if (files.size() > 1) {
+        blocks.solid = true;
+        compress("compress (solid" + threads + ")", blocks);
+        decompress("decompress (solid" + threads + ")", parallel);
+    }
+
+    std::filesystem::remove(archive);
+    std::filesystem::remove_all(output);
+}
+
+void SaveResults(Path filename, const std::vector<Result>& results) {
+    std::ofstream os(filename);
+    for (const Result& result : results) {
+        os << result.name << '\t' << result.megabytes_per_second << '\t' << result.nanoseconds_per_symbol << '\t'
+           << result.ratio << '\t' << result.peak_megabytes << '\n';
+    }
+    if (!os) {
+        throw OutputError();
+    }
+}
+
+std::map<std::string, Result> LoadResults(Path filename) {
+    std::ifstream is(filename);
+    if (!is) {
+        throw InputError();
+    }
+    std::map<std::string, Result> results;
+    for (std::string line; std::getline(is, line);) {
+        Result result;
+        std::size_t tab = line.find('\t');
+        result.name = line.substr(0, tab);
+        std::istringstream values(line.substr(tab + 1));
+        values >> result.megabytes_per_second >> result.nanoseconds_per_symbol >> result.ratio >> result.peak_megabytes;
+        results[result.name] = result;
+    }
+    return results;
+}
+
+// Prints the speed change of every benchmark present in both runs and returns whether none got slower than the
+// tolerance allows.
+bool CompareResults(const std::vector<Result>& results, const std::map<std::string, Result>& baseline,
+                    double tolerance) {
+    std::cout << "\n" << std::left << std::setw(40) << "benchmark" << std::right << std::setw(12) << "speed" << '\n';
+    bool passed = true;
+    for (const Result& result : results) {
+        auto previous = baseline.find(result.name);
+        if (previous == baseline.end()) {
+            continue;
+        }
+        double change = (previous->second.nanoseconds_per_symbol / result.nanoseconds_per_symbol - 1) * 100;
+        bool regressed = change < -tolerance;
+        passed = passed && !regressed;
+        std::cout << std::left << std::setw(40) << result.name << std::right << std::setw(11) << std::showpos
+                  << std::setprecision(1) << change << std::noshowpos << '%' << (regressed ? "  REGRESSION" : "")
+                  << '\n';
+    }
+    return passed;
+}
+
+std::size_t ParseNumber(const ArgumentParser::ParsedArguments& arguments, const std::string& option,
+                        std::size_t min_value, std::size_t max_value) {
+    const std::string& value = arguments.values.at(option);
+    std::size_t number = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc() || end != value.data() + value.size() || number < min_value || number > max_value) {
+        throw ValidationError("Invalid value of option " + option);
+    }
+    return number;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ArgumentParser parser("bench_archiver");
+    parser.AddOption("--size", "size of generated corpora in MiB", "--size MIB", true);
+    parser.AddOption("--corpus", "run only one corpus: random, skewed, text, small or huge", "--corpus NAME", true);
+    parser.AddOption("--repeat", "keep the fastest of N runs", "--repeat N", true);
+    parser.AddOption("-j", "threads for parallel end-to-end runs", "-j N", true);
+    parser.AddOption("--save", "write results to FILE", "--save FILE", true);
+    parser.AddOption("--compare", "compare with results saved to FILE, fail on regressions", "--compare FILE", true);
+    parser.AddOption("--tolerance", "allowed slowdown in percent when comparing", "--tolerance PERCENT", true);
+    parser.AddOption("-h", "show this message", "-h");
+
+    std::size_t size = DEFAULT_INPUT_MEGABYTES * MEGABYTE;
+    std::size_t repeats = DEFAULT_REPEATS;
+    std::size_t threads_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    double tolerance = DEFAULT_TOLERANCE;
+    std::vector<std::string> corpora = CORPORA;
+    ArgumentParser::ParsedArguments arguments;
+    std::map<std::string, Result> baseline;
+    try {
+        arguments = parser.ParseArguments(argc, argv);
+        if (arguments.options.contains("-h")) {
+            parser.PrintUsage();
+            return 0;
+        }
+        if (arguments.options.contains("--size")) {
+            size = ParseNumber(arguments, "--size", 1, MAX_INPUT_MEGABYTES) * MEGABYTE;
+        }
+        if (arguments.options.contains("--repeat")) {
+            repeats = ParseNumber(arguments, "--repeat", 1, MAX_REPEATS);
+        }
+        if (arguments.options.contains("-j")) {
+            threads_count = ParseNumber(arguments, "-j", 1, 1 << 10);
+        }
+        if (arguments.options.contains("--tolerance")) {
+            tolerance = static_cast<double>(ParseNumber(arguments, "--tolerance", 0, 100));
+        }
+        if (arguments.options.contains("--corpus")) {
+            corpora = {arguments.values.at("--corpus")};
+            if (std::find(CORPORA.begin(), CORPORA.end(), corpora.front()) == CORPORA.end()) {
+                throw ValidationError("Invalid value of option --corpus");
+            }
+        }
+        if (arguments.options.contains("--compare")) {
+            baseline = LoadResults(arguments.values.at("--compare"));
+        }
+    } catch (const ArchiverException& exc) {
+        std::cerr << "ERROR: " << exc.what() << "\n\n";
+        parser.PrintUsage();
+        return 111;
+    }
+
+    Path directory = std::filesystem::temp_directory_path() / "archiver_bench";
+    std::filesystem::create_directories(directory);
+    std::filesystem::current_path(directory);
+
+    Bench bench(repeats);
+    Bench::PrintHeader();
+    std::mt19937 generator(42);
+    TextGenerator text(42);
+    auto selected = [&](const std::string& corpus) {
+        return std::find(corpora.begin(), corpora.end(), corpus) != corpora.end();
+    };
+    for (std::string corpus : {"random", "skewed", "text"}) {
+        if (!selected(corpus)) {
+            continue;
+        }
+        Path filename = directory / (corpus + ".bin");
+        {
+            std::vector<std::uint8_t> data;
+            if (corpus == "random") {
+                data = GenerateRandom(size, generator);
+            } else if (corpus == "skewed") {
+                data = GenerateSkewed(size, generator);
+            } else {
+                data = text.Generate(size);
+            }
+            BenchStages(bench, corpus, data);
+            WriteFile(filename, data);
+        }
+        BenchFiles(bench, corpus, {filename}, directory, threads_count);
+        std::filesystem::remove(filename);
+    }
+    if (selected("small")) {
+        Path files_directory = directory / "small";
+        std::filesystem::create_directories(files_directory);
+        std::uniform_int_distribution<std::size_t> file_size(MIN_SMALL_FILE_SIZE, MAX_SMALL_FILE_SIZE);
+        std::vector<Path> files;
+        for (std::size_t i = 0; i < SMALL_FILES_COUNT; ++i) {
+            files.push_back(files_directory / ("file" + std::to_string(i) + ".txt"));
+            WriteFile(files.back(), text.Generate(file_size(generator)));
+        }
+        BenchFiles(bench, "small", files, directory, threads_count);
+        std::filesystem::remove_all(files_directory);
+    }
+    if (selected("huge")) {
+        Path filename = directory / "huge.txt";
+        {
+            std::ofstream os(filename, std::ios::binary);
+            for (std::size_t i = 0; i < HUGE_FILE_FACTOR; ++i) {
+                std::vector<std::uint8_t> data = text.Generate(size);
+                os.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            }
+        }
+        BenchFiles(bench, "huge", {filename}, directory, threads_count);
+        std::filesystem::remove(filename);
+    }
+
+    std::filesystem::current_path(directory.parent_path());
+    std::filesystem::remove_all(directory);
+
+    try {
+        if (arguments.options.contains("--save")) {
+            SaveResults(arguments.values.at("--save"), bench.Results());
+        }
+    } catch (const ArchiverException& exc) {
+        std::cerr << "ERROR: " << exc.what() << "\n\n";
+        return 111;
+    }
+    if (arguments.options.contains("--compare") && !CompareResults(bench.Results(), baseline, tolerance)) {
+        return 1;
+    }
+    return 0;
+}
@@ -2,92 +2,108 @@
 
 #include <algorithm>
 #include <cstddef>
-#include <memory>
 #include <tuple>
 
-const BinaryTrie BinaryTrie::DEFAULT_VALUE = BinaryTrie();
+std::strong_ordering BinaryTrie::Node::operator<=>(const Node& other) const {
+    return std::tie(count, key) <=> std::tie(other.count, other.key);
+}
 
-BinaryTrie::BinaryTrie() = default;
+bool BinaryTrie::Node::IsTerminal() const {
+    return terminal;
+}
 
-BinaryTrie::BinaryTrie(Char key, std::size_t count) : count_(count), key_(key), terminal_(true) {
+bool BinaryTrie::Node::IsLeaf() const {
+    return left == NONE;
 }
 
-BinaryTrie::BinaryTrie(Pointer left, Pointer right) : left_(left), right_(right) {
-    Relax();
+BinaryTrie::BinaryTrie() {
+    Clear();
 }
 
-std::strong_ordering BinaryTrie::operator<=>(const BinaryTrie& other) const {
-    return std::tie(count_, key_) <=> std::tie(other.count_, other.key_);
+void BinaryTrie::Clear() {
+    nodes_.assign(1, Node{});
 }
 
-bool BinaryTrie::IsTerminal() const {
-    return terminal_;
+void BinaryTrie::Reserve(std::size_t size) {
+    nodes_.reserve(size);
 }
 
-bool BinaryTrie::IsLeaf() const {
-    return left_ == nullptr;
+BinaryTrie::Index BinaryTrie::Allocate() {
+    nodes_.emplace_back();
+    return static_cast<Index>(nodes_.size() - 1);
 }
 
-void BinaryTrie::Relax() {
-    key_ = std::min(CLeft().key_, CRight().key_);
-    count_ = CLeft().count_ + CRight().count_;
+BinaryTrie::Index BinaryTrie::AddLeaf(Char key, std::size_t count) {
+    Index index = Allocate();
+    nodes_[index].key = key;
+    nodes_[index].count = count;
+    nodes_[index].terminal = true;
+    return index;
 }
 
-BinaryTrie& BinaryTrie::Left() {
-    if (left_ == nullptr) {
-        left_ = std::make_shared<BinaryTrie>();
-    }
-    return *left_;
+BinaryTrie::Index BinaryTrie::AddNode(Index left, Index right) {
+    Index index = Allocate();
+    Node& node = nodes_[index];
+    node.left = left;
+    node.right = right;
+    node.key = std::min(nodes_[left].key, nodes_[right].key);
+    node.count = nodes_[left].count + nodes_[right].count;
+    return index;
 }
 
-BinaryTrie& BinaryTrie::Right() {
-    if (right_ == nullptr) {
-        right_ = std::make_shared<BinaryTrie>();
-    }
-    return *right_;
+const BinaryTrie::Node& BinaryTrie::operator[](Index index) const {
+    return nodes_[index];
 }
 
-const BinaryTrie& BinaryTrie::CLeft() const {
-    if (left_ == nullptr) {
-        return DEFAULT_VALUE;
-    }
-    return *left_;
+BinaryTrie::Index BinaryTrie::Root() const {
+    return 0;
 }
 
-const BinaryTrie& BinaryTrie::CRight() const {
-    if (right_ == nullptr) {
-        return DEFAULT_VALUE;
-    }
-    return *right_;
+BinaryTrie::Index BinaryTrie::Child(Index index, bool bit) const {
+    return bit ? nodes_[index].right : nodes_[index].left;
 }
 
-void BinaryTrie::Traverse(Callback callback, std::size_t code, std::size_t height) const {
-    if (IsTerminal()) {
-        callback(code, height, key_);
-        return;
-    }
-    if (IsLeaf()) {
-        return;
+void BinaryTrie::Traverse(Callback callback) const {
+    Traverse(Root(), callback);
+}
+
+void BinaryTrie::Traverse(Index root, Callback callback) const {
+    std::vector<std::tuple<Index, std::size_t, std::size_t>> stack = {{root, 0, 0}};
+    while (!stack.empty()) {
+        auto [index, code, height] = stack.back();
+        stack.pop_back();
+        if (index == NONE) {
+            continue;
+        }
+        const Node& node = nodes_[index];
+        if (node.IsTerminal()) {
+            callback(code, height, node.key);
+            continue;
+        }
+        stack.emplace_back(node.right, (code << 1) | 1, height + 1);
+        stack.emplace_back(node.left, code << 1, height + 1);
     }
-    CLeft().Traverse(callback, code << 1, height + 1);
-    CRight().Traverse(callback, (code << 1) | 1, height + 1);
 }
 
-void BinaryTrie::AddCode(std::size_t code, std::size_t size, Char key, std::size_t count, std::size_t height) {
-    if (size == height) {
-        if (!IsLeaf() || IsTerminal()) {
+void BinaryTrie::AddCode(std::size_t code, std::size_t size, Char key, std::size_t count) {
+    Index index = Root();
+    for (std::size_t height = 0; height < size; ++height) {
+        if (nodes_[index].IsTerminal()) {
             throw CodeAlreadyExists();
         }
-        key_ = key;
-        count_ = count;
-        terminal_ = true;
-        return;
+        bool bit = (code >> (size - height - 1)) & 1;
+        Index child = Child(index, bit);
+        if (child == NONE) {
+            child = Allocate();
+            (bit ? nodes_[index].right : nodes_[index].left) = child;
+        }
+        index = child;
     }
-    std::size_t bit_position = size - height - 1;
-    if ((code >> bit_position) & 1) {
-        Right().AddCode(code, size, key, count, height + 1);
-    } else {
-        Left().AddCode(code, size, key, count, height + 1);
+    Node& node = nodes_[index];
+    if (node.IsTerminal() || node.left != NONE || node.right != NONE) {
+        throw CodeAlreadyExists();
     }
-    Relax();
+    node.key = key;
+    node.count = count;
+    node.terminal = true;
 }
@@ -1,71 +1,180 @@
 #include "bit_stream.h"
 
 #include <algorithm>
+#include <bit>
 #include <climits>
+#include <cstring>
 #include <iostream>
-#include <iterator>
+#include <memory>
 
-BitReader::BitReader(std::istream& is) : is_(is) {
+namespace {
+
+std::uint64_t LoadWord(const std::uint8_t* data) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, data, sizeof(word));
+    if constexpr (std::endian::native == std::endian::little) {
+        word = __builtin_bswap64(word);
+    }
+    return word;
+}
+
+void StoreWord(std::uint8_t* data, std::uint64_t word) {
+    if constexpr (std::endian::native == std::endian::little) {
+        word = __builtin_bswap64(word);
+    }
+    std::memcpy(data, &word, sizeof(word));
+}
+
+}  // namespace
+
+BitReader::BitReader(std::istream& is) : owned_source_(std::make_unique<StreamSource>(is)), source_(*owned_source_) {
+}
+
+BitReader::BitReader(InputSource& source) : source_(source) {
 }
 
 void BitReader::BufferFill() {
-    if (buffer_pos_ != buffer_size_) {
+    if (chunk_pos_ != chunk_.size() || exhausted_) {
         return;
     }
-    if (Eof()) {
-        buffer_pos_ = 0;
-        buffer_size_ = 0;
-        return;
+    chunk_offset_ += chunk_.size();
+    chunk_ = source_.Next();
+    chunk_pos_ = 0;
+    exhausted_ = chunk_.empty();
+}
+
+void BitReader::Refill() {
+    while (bits_count_ <= WORD_BITS - CHAR_BIT) {
+        if (chunk_pos_ == chunk_.size()) {
+            BufferFill();
+            if (exhausted_) {
+                return;
+            }
+        }
+        if (chunk_.size() - chunk_pos_ >= sizeof(std::uint64_t)) {
+            std::size_t bytes_count = (WORD_BITS - bits_count_) / CHAR_BIT;
+            bit_buffer_ |= LoadWord(chunk_.data() + chunk_pos_) >> bits_count_;
+            chunk_pos_ += bytes_count;
+            bits_count_ += bytes_count * CHAR_BIT;
+            if (bits_count_ < WORD_BITS) {
+                bit_buffer_ &= ~(~std::uint64_t{0} >> bits_count_);
+            }
+            return;
+        }
+        bit_buffer_ |= static_cast<std::uint64_t>(chunk_[chunk_pos_++]) << (WORD_BITS - CHAR_BIT - bits_count_);
+        bits_count_ += CHAR_BIT;
     }
-    is_.read(buffer_, BUFFER_CAPACITY);
-    buffer_size_ = is_.gcount();
-    buffer_pos_ = 0;
 }
 
-bool BitReader::Eof() const {
-    return buffer_pos_ == buffer_size_ && is_.eof();
+void BitReader::AlignToByte() {
+    ConsumeBits(bits_count_ % CHAR_BIT);
 }
 
-bool BitReader::ReadBit() {
-    if (Eof()) {
-        throw EndOfFile();
+void BitReader::ReadBytes(std::span<std::uint8_t> data) {
+    std::size_t pos = 0;
+    while (pos < data.size() && (bits_count_ > 0 || chunk_pos_ == chunk_.size())) {
+        if (bits_count_ == 0 && Eof()) {
+            throw EndOfFile();
+        }
+        data[pos++] = static_cast<std::uint8_t>(PeekBits(CHAR_BIT));
+        ConsumeBits(CHAR_BIT);
     }
-    if (buffer_pos_ == buffer_size_) {
-        BufferFill();
+    while (pos < data.size()) {
+        if (chunk_pos_ == chunk_.size()) {
+            BufferFill();
+            if (exhausted_) {
+                throw EndOfFile();
+            }
+        }
+        std::size_t count = std::min(data.size() - pos, chunk_.size() - chunk_pos_);
+        std::memcpy(data.data() + pos, chunk_.data() + chunk_pos_, count);
+        chunk_pos_ += count;
+        pos += count;
     }
-    int bit_position = CHAR_BIT - current_bit_ - 1;
-    bool bit = (buffer_[buffer_pos_] >> bit_position) & 1;
-    ++current_bit_;
-    if (current_bit_ == CHAR_BIT) {
-        current_bit_ = 0;
-        ++buffer_pos_;
+}
+
+bool BitReader::Eof() {
+    if (bits_count_ > 0) {
+        return false;
     }
+    BufferFill();
+    return exhausted_;
+}
+
+std::uint64_t BitReader::Position() const {
+    return (chunk_offset_ + chunk_pos_) * CHAR_BIT - bits_count_;
+}
+
+bool BitReader::ReadBit() {
+    bool bit = PeekBits(1);
+    ConsumeBits(1);
     return bit;
 }
 
-BitWriter::BitWriter(std::ostream& os) : os_(os) {
+BitWriter::BitWriter(std::ostream& os) : owned_sink_(std::make_unique<StreamSink>(os)), sink_(*owned_sink_) {
+}
+
+BitWriter::BitWriter(OutputSink& sink, std::uint64_t position) : flushed_(position), sink_(sink) {
 }
 
+// Errors are left to the explicit Flush of the success path, a destructor that threw would terminate the program.
 BitWriter::~BitWriter() {
+    try {
+        Flush();
+    } catch (...) {
+    }
+}
+
+void BitWriter::Flush() {
+    FlushBytes();
+    if (bits_count_ > 0) {
+        StoreWord(buffer_ + buffer_pos_, bit_buffer_);
+        ++buffer_pos_;
+        bit_buffer_ = 0;
+        bits_count_ = 0;
+    }
     BufferFlush();
 }
 
+void BitWriter::FlushBytes() {
+    std::size_t bytes_count = bits_count_ / CHAR_BIT;
+    StoreWord(buffer_ + buffer_pos_, bit_buffer_);
+    buffer_pos_ += static_cast<std::streamsize>(bytes_count);
+    bit_buffer_ = bytes_count == sizeof(std::uint64_t) ? 0 : bit_buffer_ << (bytes_count * CHAR_BIT);
+    bits_count_ -= bytes_count * CHAR_BIT;
+    if (buffer_pos_ >= BUFFER_SIZE) {
+        BufferFlush();
+    }
+}
+
 void BitWriter::BufferFlush() {
-    os_.write(buffer_, buffer_pos_ + (current_bit_ > 0));
+    sink_.Write({buffer_, static_cast<std::size_t>(buffer_pos_)});
+    flushed_ += buffer_pos_;
     buffer_pos_ = 0;
-    current_bit_ = 0;
-    std::fill(std::begin(buffer_), std::end(buffer_), 0);
+}
+
+std::uint64_t BitWriter::Position() const {
+    return (flushed_ + buffer_pos_) * CHAR_BIT + bits_count_;
 }
 
 void BitWriter::WriteBit(bool val) {
-    if (buffer_pos_ == BUFFER_SIZE) {
-        BufferFlush();
+    WriteWord(val, 1);
+}
+
+void BitWriter::WriteBytes(std::span<const std::uint8_t> data) {
+    if (bits_count_ % CHAR_BIT != 0) {
+        for (std::uint8_t byte : data) {
+            WriteWord(byte, CHAR_BIT);
+        }
+        return;
     }
-    int8_t bit_position = CHAR_BIT - current_bit_ - 1;
-    buffer_[buffer_pos_] |= static_cast<char>(val << bit_position);  // NOLINT
-    ++current_bit_;
-    if (current_bit_ == CHAR_BIT) {
-        current_bit_ = 0;
-        ++buffer_pos_;
+    FlushBytes();
+    if (data.size() <= static_cast<std::size_t>(BUFFER_SIZE - buffer_pos_)) {
+        std::memcpy(buffer_ + buffer_pos_, data.data(), data.size());
+        buffer_pos_ += static_cast<std::streamsize>(data.size());
+        return;
     }
+    BufferFlush();
+    sink_.Write(data);
+    flushed_ += data.size();
 }
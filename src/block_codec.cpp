@@ -0,0 +1,314 @@
+#include "block_codec.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <utility>
+
+#include "bit_stream.h"
+#include "decode_table.h"
+#include "exceptions.h"
+#include "huffman.h"
+#include "input_source.h"
+#include "output_sink.h"
+
+namespace {
+
+const std::size_t BYTE_VALUES = 1 << CHAR_BIT;
+const std::size_t SPLIT_STEP = 1 << 16;
+
+CodeSizes ReadByteCodeSizes(BitReader& input) {
+    CodeSizes sizes = ReadCompactCodeSizes(input);
+    for (const auto& [key, size] : sizes) {
+        if (static_cast<std::size_t>(key) >= BYTE_VALUES) {
+            throw InvalidFormat();
+        }
+    }
+    return sizes;
+}
+
+DecodeTable BuildTable(const CodeSizes& sizes) {
+    try {
+        return DecodeTable(CanonicalCodes(sizes));
+    } catch (const DecodeTable::InvalidCode& ex) {
+        throw InvalidFormat();
+    }
+}
+
+void DecodeBytes(const DecodeTable& table, BitReader& input, std::span<std::uint8_t> output) {
+    try {
+        for (std::uint8_t& c : output) {
+            c = static_cast<std::uint8_t>(table.Decode(input));
+        }
+    } catch (const DecodeTable::InvalidCode& ex) {
+        throw InvalidFormat();
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+}
+
+}  // namespace
+
+EncodedBlock EncodeBlock(std::span<const std::uint8_t> data, std::size_t max_code_size) {
+    return std::move(EncodeBlockGroup({data}, max_code_size).front());
+}
+
+std::vector<EncodedBlock> EncodeBlockGroup(const std::vector<std::span<const std::uint8_t>>& parts,
+                                           std::size_t max_code_size) {
+    std::size_t limit = max_code_size == 0 ? MAX_CODE_SIZE : max_code_size;
+    std::vector<EncodedBlock> blocks;
+    blocks.reserve(parts.size());
+    std::size_t begin = 0;
+    while (begin < parts.size()) {
+        SymbolsCount symbols_count{};
+        std::size_t bits = 0;
+        std::size_t end = begin;
+        for (; end < parts.size(); ++end) {
+            SymbolsCount part_count{};
+            CountBytes(parts[end], part_count);
+            SymbolsCount merged = symbols_count;
+            for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+                merged[c] += part_count[c];
+            }
+            std::size_t merged_bits = EncodedBits(merged, limit);
+            if (bits > 0 && !parts[end].empty() && merged_bits > bits + EncodedBits(part_count, limit)) {
+                break;
+            }
+            symbols_count = merged;
+            bits = merged_bits;
+        }
+
+        CodeSizes sizes = LimitedHuffmanEncoding(symbols_count, limit);
+        CodeTable codes = CanonicalCodes(sizes);
+        bool has_table = false;
+        for (; begin < end; ++begin) {
+            std::span<const std::uint8_t> part = parts[begin];
+            EncodedBlock& block = blocks.emplace_back(EncodedBlock{part.size(), {}, has_table});
+            MemorySink sink(block.payload);
+            BitWriter output(sink);
+            if (!block.shared_table) {
+                WriteCompactCodeSizes(output, sizes);
+            }
+            EncodeBuffer(output, codes, part);
+            output.Flush();
+            has_table = has_table || !part.empty();
+        }
+    }
+    return blocks;
+}
+
+void DecodeBlock(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) {
+    MemorySource source(payload);
+    BitReader input(source);
+    DecodeBytes(BuildTable(ReadByteCodeSizes(input)), input, output);
+}
+
+DecodeTable ReadSharedBlockTable(std::span<const std::uint8_t> table_payload) {
+    MemorySource source(table_payload);
+    BitReader input(source);
+    return BuildTable(ReadByteCodeSizes(input));
+}
+
+void DecodeSharedBlock(const DecodeTable& table, std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) {
+    MemorySource source(payload);
+    BitReader input(source);
+    DecodeBytes(table, input, output);
+}
+
+std::vector<std::size_t> SplitBlock(std::span<const std::uint8_t> data, std::size_t max_code_size) {
+    std::size_t limit = max_code_size == 0 ? MAX_CODE_SIZE : max_code_size;
+    std::vector<std::size_t> sizes;
+    SymbolsCount current{};
+    std::size_t current_size = 0;
+    std::size_t current_bits = 0;
+    for (std::size_t offset = 0; offset < data.size(); offset += SPLIT_STEP) {
+        std::span<const std::uint8_t> part = data.subspan(offset, std::min(SPLIT_STEP, data.size() - offset));
+        SymbolsCount next{};
+        CountBytes(part, next);
+        std::size_t next_bits = EncodedBits(next, limit);
+        if (current_size == 0) {
+            current = next;
+            current_size = part.size();
+            current_bits = next_bits;
+            continue;
+        }
+        SymbolsCount merged = current;
+        for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+            merged[c] += next[c];
+        }
+        std::size_t merged_bits = EncodedBits(merged, limit);
+        if (current_bits + next_bits + BLOCK_OVERHEAD_BITS < merged_bits) {
+            sizes.push_back(current_size);
+            current = next;
+            current_size = part.size();
+            current_bits = next_bits;
+        } else {
+            current = merged;
+            current_size += part.size();
+            current_bits = merged_bits;
+        }
+    }
+    if (current_size > 0) {
+        sizes.push_back(current_size);
+    }
+    return sizes;
+}
+
+std::vector<std::size_t> BlockCodec::Split(std::span<const std::uint8_t> data) const {
+    return {data.size()};
+}
+
+std::vector<EncodedBlock> BlockCodec::EncodeGroup(const std::vector<std::span<const std::uint8_t>>& parts) const {
+    std::vector<EncodedBlock> blocks;
+    blocks.reserve(parts.size());
+    for (std::span<const std::uint8_t> part : parts) {
+        blocks.push_back(Encode(part));
+    }
+    return blocks;
+}
+
+std::shared_ptr<const DecodeTable> BlockCodec::ReadSharedTable(std::span<const std::uint8_t>) const {
+    throw InvalidFormat();
+}
+
+void BlockCodec::DecodeShared(const DecodeTable&, std::span<const std::uint8_t>, std::span<std::uint8_t>) const {
+    throw InvalidFormat();
+}
+
+HuffmanCodec::HuffmanCodec(std::size_t max_code_size, bool adaptive, std::shared_ptr<const Dictionary> dictionary)
+    : max_code_size_(max_code_size), adaptive_(adaptive), dictionary_(std::move(dictionary)) {
+    if (!dictionary_) {
+        return;
+    }
+    dictionary_codes_ = CanonicalCodes(dictionary_->sizes);
+    try {
+        dictionary_table_ = std::make_shared<DecodeTable>(dictionary_codes_);
+    } catch (const DecodeTable::InvalidCode& ex) {
+        throw InvalidDictionary();
+    }
+}
+
+EncodedBlock HuffmanCodec::Encode(std::span<const std::uint8_t> data) const {
+    if (!dictionary_) {
+        return EncodeBlock(data, max_code_size_);
+    }
+    SymbolsCount symbols_count{};
+    CountBytes(data, symbols_count);
+    std::size_t dictionary_bits = 0;
+    for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+        dictionary_bits += symbols_count[c] * dictionary_codes_[c].size;
+    }
+    std::size_t limit = max_code_size_ == 0 ? MAX_CODE_SIZE : max_code_size_;
+    bool use_dictionary = dictionary_bits <= EncodedBits(symbols_count, limit);
+
+    EncodedBlock block{data.size(), {}};
+    MemorySink sink(block.payload);
+    BitWriter output(sink);
+    output.WriteBits(use_dictionary, 1);
+    if (use_dictionary) {
+        EncodeBuffer(output, dictionary_codes_, data);
+    } else {
+        CodeSizes sizes = LimitedHuffmanEncoding(symbols_count, limit);
+        WriteCompactCodeSizes(output, sizes);
+        EncodeBuffer(output, CanonicalCodes(sizes), data);
+    }
+    output.Flush();
+    return block;
+}
+
+void HuffmanCodec::Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const {
+    if (!dictionary_) {
+        DecodeBlock(payload, output);
+        return;
+    }
+    MemorySource source(payload);
+    BitReader input(source);
+    bool use_dictionary = false;
+    try {
+        use_dictionary = input.ReadBit();
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+    if (use_dictionary) {
+        DecodeBytes(*dictionary_table_, input, output);
+    } else {
+        DecodeBytes(BuildTable(ReadByteCodeSizes(input)), input, output);
+    }
+}
+
+std::vector<EncodedBlock> HuffmanCodec::EncodeGroup(const std::vector<std::span<const std::uint8_t>>& parts) const {
+    if (dictionary_) {
+        return BlockCodec::EncodeGroup(parts);
+    }
+    return EncodeBlockGroup(parts, max_code_size_);
+}
+
+std::shared_ptr<const DecodeTable> HuffmanCodec::ReadSharedTable(std::span<const std::uint8_t> table_payload) const {
+    if (dictionary_) {
+        return BlockCodec::ReadSharedTable(table_payload);
+    }
+    return std::make_shared<DecodeTable>(ReadSharedBlockTable(table_payload));
+}
+
+void HuffmanCodec::DecodeShared(const DecodeTable& table, std::span<const std::uint8_t> payload,
+                                std::span<std::uint8_t> output) const {
+    if (dictionary_) {
+        BlockCodec::DecodeShared(table, payload, output);
+        return;
+    }
+    DecodeSharedBlock(table, payload, output);
+}
+
+std::vector<std::size_t> HuffmanCodec::Split(std::span<const std::uint8_t> data) const {
+    if (!adaptive_) {
+        return BlockCodec::Split(data);
+    }
+    return SplitBlock(data, max_code_size_);
+}
+
+EncodedBlock RansCodec::Encode(std::span<const std::uint8_t> data) const {
+    return EncodeRansBlock(data);
+}
+
+void RansCodec::Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const {
+    DecodeRansBlock(payload, output);
+}
+
+Lz77Codec::Lz77Codec(const Lz77Options& options, std::size_t max_code_size)
+    : options_(options), max_code_size_(max_code_size) {
+}
+
+EncodedBlock Lz77Codec::Encode(std::span<const std::uint8_t> data) const {
+    return EncodeLz77Block(data, options_, max_code_size_);
+}
+
+void Lz77Codec::Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const {
+    DecodeLz77Block(payload, output);
+}
+
+std::shared_ptr<const BlockCodec> CreateCodec(CodecId codec) {
+    CompressOptions options;
+    options.codec = codec;
+    return CreateCodec(options);
+}
+
+std::shared_ptr<const BlockCodec> CreateCodec(const CompressOptions& options,
+                                              std::shared_ptr<const Dictionary> dictionary) {
+    switch (options.codec) {
+        case CodecId::Rans:
+            return std::make_shared<RansCodec>();
+        case CodecId::Lz77: {
+            Lz77Options lz77;
+            if (options.level != 0) {
+                lz77.level = options.level;
+            }
+            if (options.window_bits != 0) {
+                lz77.window_bits = options.window_bits;
+            }
+            return std::make_shared<Lz77Codec>(lz77, options.max_code_size);
+        }
+        case CodecId::Huffman:
+        default:
+            return std::make_shared<HuffmanCodec>(options.max_code_size, options.adaptive, std::move(dictionary));
+    }
+}
@@ -0,0 +1,346 @@
+#include "block_compressor.h"
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+
+#include "archive_format.h"
+#include "block_codec.h"
+#include "checksum.h"
+#include "dedup.h"
+#include "dictionary.h"
+#include "exceptions.h"
+#include "input_source.h"
+#include "output_sink.h"
+#include "stats.h"
+
+namespace {
+
+std::vector<std::uint8_t> ReadFile(Path filename) {
+    std::vector<std::uint8_t> data;
+    auto input = OpenSource(filename);
+    for (auto chunk = input->Next(); !chunk.empty(); chunk = input->Next()) {
+        data.insert(data.end(), chunk.begin(), chunk.end());
+    }
+    return data;
+}
+
+void EncodeParts(const BlockCodec& codec, std::span<const std::uint8_t> data, std::vector<EncodedBlock>& encoded) {
+    for (std::size_t size : codec.Split(data)) {
+        EncodedBlock& block = encoded.emplace_back(codec.Encode(data.first(size)));
+        block.checksum = Crc32c(data.first(size));
+        data = data.subspan(size);
+    }
+}
+
+}  // namespace
+
+BlockCompressor::BlockCompressor(Path archive_name, const CompressOptions& options,
+                                 std::optional<AppendPoint> append_point)
+    : os_(archive_name, append_point ? std::ios::binary | std::ios::in | std::ios::out : std::ios::binary),
+      sink_(std::make_unique<StreamSink>(os_), options.io_chunk_size),
+      output_(sink_, append_point ? append_point->archive_size : 0),
+      block_size_(options.block_size),
+      io_chunk_size_(options.io_chunk_size),
+      solid_(options.solid),
+      stats_(options.stats),
+      max_chunk_size_(std::min(block_size_, MAX_CHUNK_SIZE)),
+      chunk_index_(options.dedup ? std::make_shared<ChunkIndex>() : nullptr),
+      dictionary_(options.dictionary.empty() ? nullptr
+                                             : std::make_shared<Dictionary>(LoadDictionary(options.dictionary))),
+      codec_(CreateCodec(options, dictionary_)),
+      max_pending_(2 * std::max<std::size_t>(options.threads_count, 1)),
+      pool_(options.threads_count) {
+    ArchiveHeader header{options.codec, dictionary_ ? dictionary_->id : 0};
+    if (!append_point) {
+        WriteArchiveHeader(output_, header);
+        return;
+    }
+    if (append_point->header.dictionary_id != header.dictionary_id) {
+        if (!dictionary_) {
+            throw MissingDictionary();
+        }
+        throw DictionaryMismatch();
+    }
+    if (append_point->header.codec != header.codec) {
+        throw InvalidFormat();
+    }
+    os_.seekp(static_cast<std::streamoff>(append_point->archive_size));
+    if (!os_) {
+        throw OutputError();
+    }
+    directory_ = std::move(append_point->directory);
+}
+
+std::vector<BlockCompressor::EncodedChunk> BlockCompressor::EncodeChunks(const BlockCodec& codec,
+                                                                         std::span<const std::uint8_t> data,
+                                                                         const std::vector<std::size_t>& sizes,
+                                                                         const ChunkIndex* index) {
+    std::vector<EncodedChunk> encoded;
+    for (std::size_t size : sizes) {
+        EncodedChunk& chunk = encoded.emplace_back();
+        std::span<const std::uint8_t> piece = data.first(size);
+        data = data.subspan(size);
+        if (index != nullptr) {
+            chunk.key = MakeChunkKey(piece);
+            if (index->Contains(*chunk.key)) {
+                chunk.checksum = Crc32c(piece);
+                continue;
+            }
+        }
+        EncodeParts(codec, piece, chunk.blocks);
+        for (const EncodedBlock& block : chunk.blocks) {
+            chunk.checksum = Crc32cCombine(chunk.checksum, block.checksum, block.raw_size);
+        }
+    }
+    return encoded;
+}
+
+// Returns the start of the next block. With deduplication the last chunk of a block is carried over when more data
+// follows, since where it ends is not known yet.
+std::vector<std::uint8_t> BlockCompressor::SubmitBlock(std::vector<std::uint8_t> block, bool is_last) {
+    std::vector<std::size_t> sizes = {block.size()};
+    std::vector<std::uint8_t> next;
+    if (chunk_index_) {
+        sizes = FindChunks(block, max_chunk_size_);
+        if (!is_last && sizes.size() > 1) {
+            next.assign(block.end() - static_cast<std::ptrdiff_t>(sizes.back()), block.end());
+            block.resize(block.size() - sizes.back());
+            sizes.pop_back();
+        }
+    }
+    WritePending(max_pending_ - 1);
+    pending_.push_back({{},
+                        pool_.Submit([block = std::move(block), sizes = std::move(sizes), codec = codec_,
+                                      index = chunk_index_, timed = stats_ != nullptr] {
+                            EncodedMembers encoded;
+                            {
+                                StageTimer timer(timed ? &encoded.stats : nullptr, Stage::Encode);
+                                encoded.chunks = {EncodeChunks(*codec, block, sizes, index.get())};
+                            }
+                            return encoded;
+                        })});
+    next.reserve(block_size_);
+    return next;
+}
+
+void BlockCompressor::SubmitFile(const std::string& name, Path filename) {
+    WritePending(max_pending_ - 1);
+    MemberEntry member;
+    member.name = name;
+    pending_.push_back({{std::move(member)}, pool_.Submit([filename = std::move(filename), codec = codec_,
+                                                           block_size = block_size_, max_chunk_size = max_chunk_size_,
+                                                           index = chunk_index_, timed = stats_ != nullptr] {
+                            EncodedMembers encoded;
+                            Stats* stats = timed ? &encoded.stats : nullptr;
+                            std::vector<std::uint8_t> data;
+                            {
+                                StageTimer timer(stats, Stage::Open);
+                                data = ReadFile(filename);
+                            }
+                            StageTimer timer(stats, Stage::Encode);
+                            std::vector<std::size_t> sizes;
+                            if (index) {
+                                sizes = FindChunks(data, max_chunk_size);
+                            } else {
+                                for (std::size_t offset = 0; offset < data.size(); offset += block_size) {
+                                    sizes.push_back(std::min(block_size, data.size() - offset));
+                                }
+                            }
+                            encoded.chunks = {EncodeChunks(*codec, data, sizes, index.get())};
+                            return encoded;
+                        })});
+}
+
+void BlockCompressor::AddToGroup(const std::string& name, Path filename, std::size_t size) {
+    if (group_size_ + size > block_size_) {
+        SubmitGroup();
+    }
+    MemberEntry& member = group_.emplace_back();
+    member.name = name;
+    group_size_ += size;
+    group_files_.push_back(std::move(filename));
+}
+
+void BlockCompressor::SubmitGroup() {
+    if (group_.empty()) {
+        return;
+    }
+    WritePending(max_pending_ - 1);
+    pending_.push_back({std::move(group_), pool_.Submit([files = std::move(group_files_), codec = codec_,
+                                                          timed = stats_ != nullptr] {
+                            EncodedMembers encoded;
+                            Stats* stats = timed ? &encoded.stats : nullptr;
+                            std::vector<std::vector<std::uint8_t>> parts;
+                            {
+                                StageTimer timer(stats, Stage::Open);
+                                for (const Path& file : files) {
+                                    parts.push_back(ReadFile(file));
+                                }
+                            }
+                            StageTimer timer(stats, Stage::Encode);
+                            std::vector<EncodedBlock> blocks = codec->EncodeGroup({parts.begin(), parts.end()});
+                            encoded.chunks.resize(files.size());
+                            for (std::size_t i = 0; i < blocks.size(); ++i) {
+                                if (blocks[i].raw_size > 0) {
+                                    blocks[i].checksum = Crc32c(parts[i]);
+                                    encoded.chunks[i].emplace_back().blocks.push_back(std::move(blocks[i]));
+                                }
+                            }
+                            return encoded;
+                        })});
+    group_ = {};
+    group_files_ = {};
+    group_size_ = 0;
+}
+
+void BlockCompressor::WritePending(std::size_t max_pending) {
+    while (pending_.size() > max_pending) {
+        PendingBlocks& pending = pending_.front();
+        EncodedMembers encoded = pending.encoded.get();
+        if (STATS_ENABLED && stats_) {
+            MergeStats(*stats_, encoded.stats);
+        }
+        StageTimer timer(stats_, Stage::WriteFile);
+        const std::vector<std::vector<EncodedChunk>>& chunks = encoded.chunks;
+        if (pending.members.empty()) {
+            WriteChunks(chunks.front());
+        }
+        for (std::size_t i = 0; i < pending.members.size(); ++i) {
+            WriteMemberStart(std::move(pending.members[i]));
+            WriteChunks(chunks[i]);
+            WriteMemberEnd();
+        }
+        pending_.pop_front();
+    }
+}
+
+void BlockCompressor::WriteMemberStart(MemberEntry member) {
+    member.header_offset = output_.Position() / CHAR_BIT;
+    output_.WriteBits(member.name.size(), NAME_SIZE_BITS);
+    output_.WriteBytes({reinterpret_cast<const std::uint8_t*>(member.name.data()), member.name.size()});
+    directory_.push_back(std::move(member));
+}
+
+void BlockCompressor::WriteMemberEnd() {
+    MemberEntry& member = directory_.back();
+    output_.WriteBits(0, BLOCK_SIZE_BITS);
+    member.compressed_size = output_.Position() / CHAR_BIT - member.header_offset;
+    if (STATS_ENABLED && stats_) {
+        ++stats_->files;
+        stats_->bytes_in += member.size;
+        stats_->bytes_out += member.compressed_size;
+    }
+}
+
+void BlockCompressor::WriteChunks(const std::vector<EncodedChunk>& chunks) {
+    for (const EncodedChunk& chunk : chunks) {
+        if (chunk.key) {
+            if (const std::vector<BlockEntry>* targets = chunk_index_->Find(*chunk.key)) {
+                for (const BlockEntry& target : *targets) {
+                    WriteReference(target);
+                }
+                MemberEntry& member = directory_.back();
+                member.checksum = Crc32cCombine(member.checksum, chunk.checksum, chunk.key->size);
+                continue;
+            }
+        }
+        const std::vector<BlockEntry>& written = directory_.back().blocks;
+        std::size_t first = written.size();
+        for (const EncodedBlock& block : chunk.blocks) {
+            WriteBlock(block);
+        }
+        if (chunk.key) {
+            chunk_index_->Insert(*chunk.key, {written.begin() + static_cast<std::ptrdiff_t>(first), written.end()});
+        }
+    }
+}
+
+void BlockCompressor::WriteBlock(const EncodedBlock& block) {
+    output_.WriteBits(block.raw_size | (block.shared_table ? SHARED_TABLE_FLAG : 0), BLOCK_SIZE_BITS);
+    output_.WriteBits(block.payload.size(), BLOCK_SIZE_BITS);
+    output_.WriteBits(block.checksum, CHECKSUM_BITS);
+    MemberEntry& member = directory_.back();
+    member.blocks.push_back({output_.Position() / CHAR_BIT, block.payload.size(), block.raw_size, member.size,
+                             block.shared_table, block.checksum});
+    member.checksum = Crc32cCombine(member.checksum, block.checksum, block.raw_size);
+    member.size += block.raw_size;
+    output_.WriteBytes(block.payload);
+}
+
+void BlockCompressor::WriteReference(const BlockEntry& target) {
+    output_.WriteBits(target.raw_size, BLOCK_SIZE_BITS);
+    output_.WriteBits(REFERENCE_PAYLOAD_SIZE, BLOCK_SIZE_BITS);
+    output_.WriteBits(target.checksum, CHECKSUM_BITS);
+    output_.WriteBits(target.payload_offset, OFFSET_BITS);
+    output_.WriteBits(target.payload_size, BLOCK_SIZE_BITS);
+    MemberEntry& member = directory_.back();
+    member.blocks.push_back(
+        {target.payload_offset, target.payload_size, target.raw_size, member.size, false, target.checksum});
+    member.size += target.raw_size;
+}
+
+void BlockCompressor::CompressFile(const InputFile& input_file, bool is_last) {
+    const Path& filename = input_file.path;
+    std::string name = filename == STANDARD_STREAM ? STANDARD_INPUT_NAME : input_file.name;
+    if (name.empty() || name.size() > MAX_NAME_SIZE) {
+        throw InputError();
+    }
+
+    bool seekable = IsSeekable(filename);
+    std::size_t size = seekable ? std::filesystem::file_size(filename) : 0;
+    if (seekable && solid_ && size < block_size_) {
+        AddToGroup(name, filename, size);
+    } else if (seekable && size <= block_size_) {
+        SubmitGroup();
+        SubmitFile(name, filename);
+    } else {
+        SubmitGroup();
+        WritePending(0);
+        std::unique_ptr<InputSource> input;
+        {
+            StageTimer timer(stats_, Stage::Open);
+            input = OpenPrefetchSource(filename, io_chunk_size_);
+        }
+        MemberEntry member;
+        member.name = name;
+        WriteMemberStart(std::move(member));
+        std::vector<std::uint8_t> block;
+        block.reserve(block_size_);
+        for (auto chunk = input->Next(); !chunk.empty(); chunk = input->Next()) {
+            while (!chunk.empty()) {
+                std::size_t count = std::min(chunk.size(), block_size_ - block.size());
+                block.insert(block.end(), chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(count));
+                chunk = chunk.subspan(count);
+                if (block.size() == block_size_) {
+                    block = SubmitBlock(std::move(block), false);
+                }
+            }
+        }
+        if (!block.empty()) {
+            SubmitBlock(std::move(block), true);
+        }
+        WritePending(0);
+        WriteMemberEnd();
+    }
+
+    if (is_last) {
+        Finish();
+    }
+}
+
+void BlockCompressor::Finish() {
+    SubmitGroup();
+    WritePending(0);
+    StageTimer timer(stats_, Stage::WriteFile);
+    output_.WriteBits(0, NAME_SIZE_BITS);
+    WriteArchiveDirectory(output_, directory_);
+    output_.Flush();
+    sink_.Close();
+    if (!os_.flush()) {
+        throw OutputError();
+    }
+}
@@ -0,0 +1,321 @@
+#include "block_decompressor.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include "archive_format.h"
+#include "block_codec.h"
+#include "checksum.h"
+#include "dictionary.h"
+#include "exceptions.h"
+
+namespace {
+
+// Returns nullptr when the archive needs a dictionary that was not given.
+std::shared_ptr<const BlockCodec> OpenCodec(const ArchiveHeader& header, Path dictionary_name) {
+    if (header.dictionary_id == 0) {
+        return CreateCodec(header.codec);
+    }
+    if (dictionary_name.empty()) {
+        return nullptr;
+    }
+    auto dictionary = std::make_shared<Dictionary>(LoadDictionary(dictionary_name));
+    if (dictionary->id != header.dictionary_id) {
+        throw DictionaryMismatch();
+    }
+    CompressOptions options;
+    options.codec = header.codec;
+    return CreateCodec(options, std::move(dictionary));
+}
+
+}  // namespace
+
+BlockDecompressor::BlockDecompressor(Path archive_name, OutputMode output_mode, Path dictionary,
+                                     std::size_t io_chunk_size, Stats* stats)
+    : source_(OpenPrefetchSource(archive_name, io_chunk_size)),
+      input_(*source_),
+      archive_(RandomAccessFile::Open(archive_name)),
+      archive_end_(FindArchiveEnd(archive_)),
+      output_mode_(output_mode),
+      io_chunk_size_(io_chunk_size),
+      stats_(stats),
+      codec_(OpenCodec(ReadArchiveHeader(input_), dictionary)) {
+    if (!codec_) {
+        throw MissingDictionary();
+    }
+}
+
+void BlockDecompressor::OpenFile(Path filename) {
+    if (output_mode_ == OutputMode::Discard) {
+        sink_ = nullptr;
+        return;
+    }
+    if (output_mode_ == OutputMode::StandardOutput) {
+        os_ = &std::cout;
+    } else {
+        file_ = std::ofstream(PrepareOutput(filename.string()), std::ios::binary);
+        os_ = &file_;
+    }
+    sink_ = std::make_unique<AsyncSink>(std::make_unique<StreamSink>(*os_), io_chunk_size_);
+}
+
+std::size_t BlockDecompressor::ReadSize(std::size_t bits) {
+    try {
+        return input_.ReadBits<std::size_t>(bits);
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+}
+
+std::string BlockDecompressor::ReadName(std::size_t size) {
+    std::string name(size, '\0');
+    try {
+        input_.ReadBytes({reinterpret_cast<std::uint8_t*>(name.data()), name.size()});
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+    return name;
+}
+
+bool BlockDecompressor::DecompressFile() {
+    std::size_t name_size = ReadSize(NAME_SIZE_BITS);
+    // Every append ends with a directory of all members so far, members added later follow its trailer.
+    while (name_size == 0) {
+        VerifyDirectory();
+        if (input_.Position() / CHAR_BIT == archive_end_) {
+            return false;
+        }
+        name_size = ReadSize(NAME_SIZE_BITS);
+    }
+    MemberEntry& member = members_.emplace_back();
+    member.name = ReadName(name_size);
+    OpenFile(member.name);
+
+    std::vector<std::uint8_t> payload;
+    std::vector<std::uint8_t> block;
+    while (std::size_t raw_size = ReadSize(BLOCK_SIZE_BITS)) {
+        bool shared_table = raw_size & SHARED_TABLE_FLAG;
+        raw_size &= ~SHARED_TABLE_FLAG;
+        std::size_t payload_size = ReadSize(BLOCK_SIZE_BITS);
+        auto checksum = static_cast<std::uint32_t>(ReadSize(CHECKSUM_BITS));
+        if (raw_size == 0 || raw_size > MAX_BLOCK_SIZE || payload_size > MaxPayloadSize(raw_size) ||
+            (shared_table && table_payload_.empty())) {
+            throw InvalidFormat();
+        }
+        if (payload_size == REFERENCE_PAYLOAD_SIZE) {
+            std::uint64_t position = input_.Position() / CHAR_BIT;
+            std::uint64_t offset = ReadSize(OFFSET_BITS);
+            payload_size = ReadSize(BLOCK_SIZE_BITS);
+            if (shared_table || payload_size == 0 || payload_size > MaxPayloadSize(raw_size) ||
+                payload_size > position || offset > position - payload_size) {
+                throw InvalidFormat();
+            }
+            payload.resize(payload_size);
+            archive_.ReadAt(payload, offset);
+        } else {
+            if (payload_size > archive_.Size() - input_.Position() / CHAR_BIT) {
+                throw InvalidFormat();
+            }
+            payload.resize(payload_size);
+            try {
+                input_.ReadBytes(payload);
+            } catch (const BitReader::EndOfFile& ex) {
+                throw InvalidFormat();
+            }
+        }
+        block.resize(raw_size);
+        {
+            StageTimer timer(stats_, Stage::Decode);
+            if (shared_table) {
+                if (!shared_table_) {
+                    shared_table_ = codec_->ReadSharedTable(table_payload_);
+                }
+                codec_->DecodeShared(*shared_table_, payload, block);
+            } else {
+                codec_->Decode(payload, block);
+                std::swap(payload, table_payload_);
+                shared_table_ = nullptr;
+            }
+            if (Crc32c(block) != checksum) {
+                throw ChecksumMismatch();
+            }
+        }
+        member.checksum = Crc32cCombine(member.checksum, checksum, raw_size);
+        member.size += raw_size;
+        if (sink_) {
+            StageTimer timer(stats_, Stage::WriteOutput);
+            sink_->Write(block);
+        }
+    }
+    if (sink_) {
+        sink_->Close();
+        if (!os_->flush()) {
+            throw OutputError();
+        }
+    }
+    if (STATS_ENABLED && stats_) {
+        ++stats_->files;
+        stats_->bytes_in = input_.Position() / CHAR_BIT;
+        stats_->bytes_out += member.size;
+    }
+    return true;
+}
+
+void BlockDecompressor::VerifyDirectory() {
+    std::uint64_t directory_offset = input_.Position() / CHAR_BIT;
+    ArchiveDirectory directory = ReadArchiveDirectory(input_, directory_offset);
+    std::array<std::uint8_t, DIRECTORY_MAGIC.size()> magic{};
+    if (ReadSize(OFFSET_BITS) != directory_offset) {
+        throw InvalidFormat();
+    }
+    try {
+        input_.ReadBytes(magic);
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+    if (magic != DIRECTORY_MAGIC || directory.size() != members_.size()) {
+        throw InvalidFormat();
+    }
+    for (std::size_t i = 0; i < directory.size(); ++i) {
+        if (directory[i].name != members_[i].name || directory[i].size != members_[i].size) {
+            throw InvalidFormat();
+        }
+        if (directory[i].checksum != members_[i].checksum) {
+            throw ChecksumMismatch();
+        }
+    }
+}
+
+IndexedDecompressor::IndexedDecompressor(Path archive_name, std::size_t threads_count, Path dictionary,
+                                         Stats* stats)
+    : archive_(std::make_shared<RandomAccessFile>(RandomAccessFile::Open(archive_name))),
+      codec_(OpenCodec(ReadArchiveHeader(*archive_), dictionary)),
+      directory_(ReadArchiveDirectory(*archive_)),
+      stats_(stats),
+      max_pending_(2 * std::max<std::size_t>(threads_count, 1)),
+      pool_(threads_count) {
+    const BlockEntry* table = nullptr;
+    for (const MemberEntry& member : directory_) {
+        members_[member.name] = &member;
+        for (const BlockEntry& block : member.blocks) {
+            if (!block.shared_table) {
+                table = &block;
+            } else if (table == nullptr) {
+                throw InvalidFormat();
+            } else {
+                tables_[&block] = table;
+            }
+        }
+    }
+}
+
+void IndexedDecompressor::VerifyMember(const MemberEntry& member) {
+    std::uint32_t checksum = std::exchange(checksum_, 0);
+    verified_size_ = 0;
+    if (checksum != member.checksum) {
+        throw ChecksumMismatch();
+    }
+}
+
+void IndexedDecompressor::WaitPending(std::size_t max_pending) {
+    while (pending_.size() > max_pending) {
+        PendingBlock& block = pending_.front();
+        checksum_ = Crc32cCombine(checksum_, block.checksum.get(), block.raw_size);
+        verified_size_ += block.raw_size;
+        if (verified_size_ == block.member->size) {
+            VerifyMember(*block.member);
+        }
+        pending_.pop_front();
+    }
+}
+
+void IndexedDecompressor::DecompressFile(const MemberEntry& member, OutputMode output_mode) {
+    if (!codec_) {
+        throw MissingDictionary();
+    }
+    if (STATS_ENABLED && stats_) {
+        ++stats_->files;
+        stats_->bytes_in += member.compressed_size;
+        stats_->bytes_out += member.size;
+    }
+    std::shared_ptr<RandomAccessFile> output;
+    if (output_mode == OutputMode::Files) {
+        output = std::make_shared<RandomAccessFile>(RandomAccessFile::Create(PrepareOutput(member.name), member.size));
+    }
+    if (member.blocks.empty()) {
+        WaitPending(0);
+        VerifyMember(member);
+    }
+    for (const BlockEntry& block : member.blocks) {
+        WaitPending(max_pending_ - 1);
+        std::shared_ptr<const DecodeTable> table;
+        if (block.shared_table) {
+            const BlockEntry* owner = tables_.at(&block);
+            if (owner != shared_table_owner_) {
+                std::vector<std::uint8_t> table_payload(owner->payload_size);
+                archive_->ReadAt(table_payload, owner->payload_offset);
+                shared_table_ = codec_->ReadSharedTable(table_payload);
+                shared_table_owner_ = owner;
+            }
+            table = shared_table_;
+        }
+        pending_.push_back({&member, block.raw_size,
+                            pool_.Submit([archive = archive_, codec = codec_, output, block, table] {
+                                std::vector<std::uint8_t> payload(block.payload_size);
+                                archive->ReadAt(payload, block.payload_offset);
+                                std::vector<std::uint8_t> data(block.raw_size);
+                                if (table) {
+                                    codec->DecodeShared(*table, payload, data);
+                                } else {
+                                    codec->Decode(payload, data);
+                                }
+                                std::uint32_t checksum = Crc32c(data);
+                                if (checksum != block.checksum) {
+                                    throw ChecksumMismatch();
+                                }
+                                if (output) {
+                                    output->WriteAt(data, block.output_offset);
+                                }
+                                return checksum;
+                            })});
+    }
+}
+
+void IndexedDecompressor::DecompressAll() {
+    for (const MemberEntry& member : directory_) {
+        if (members_.at(member.name) == &member) {
+            DecompressFile(member);
+        }
+    }
+    WaitPending(0);
+}
+
+void IndexedDecompressor::TestAll() {
+    for (const MemberEntry& member : directory_) {
+        DecompressFile(member, OutputMode::Discard);
+    }
+    WaitPending(0);
+}
+
+void IndexedDecompressor::DecompressFiles(const std::vector<std::string>& names) {
+    for (const std::string& name : names) {
+        auto member = members_.find(name);
+        if (member == members_.end()) {
+            throw MemberNotFound();
+        }
+        DecompressFile(*member->second);
+    }
+    WaitPending(0);
+}
+
+void IndexedDecompressor::List(std::ostream& os) const {
+    for (const MemberEntry& member : directory_) {
+        os << std::setw(12) << member.size << ' ' << std::setw(12) << member.compressed_size << ' ' << std::hex
+           << std::setfill('0') << std::setw(8) << member.checksum << std::dec << std::setfill(' ') << ' '
+           << member.name << '\n';
+    }
+}
@@ -0,0 +1,293 @@
+#include "checksum.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+const std::uint32_t POLYNOMIAL = 0x82F63B78;
+const std::uint32_t HIGH_BIT = std::uint32_t{1} << 31;
+const std::size_t TABLES_COUNT = 8;
+const std::size_t POWERS_COUNT = 3 + sizeof(std::uint64_t) * CHAR_BIT;
+const std::size_t STRIPE_SIZE = 1 << 13;
+
+using Table = std::array<std::array<std::uint32_t, 1 << CHAR_BIT>, TABLES_COUNT>;
+
+Table GenerateTable() {
+    Table table{};
+    for (std::uint32_t byte = 0; byte < table[0].size(); ++byte) {
+        std::uint32_t crc = byte;
+        for (std::size_t bit = 0; bit < CHAR_BIT; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+        }
+        table[0][byte] = crc;
+    }
+    for (std::size_t i = 1; i < TABLES_COUNT; ++i) {
+        for (std::size_t byte = 0; byte < table[i].size(); ++byte) {
+            std::uint32_t previous = table[i - 1][byte];
+            table[i][byte] = (previous >> CHAR_BIT) ^ table[0][previous & 0xFF];
+        }
+    }
+    return table;
+}
+
+const Table TABLE = GenerateTable();
+
+std::uint32_t MultiplyModulo(std::uint32_t lhs, std::uint32_t rhs) {
+    std::uint32_t product = 0;
+    for (std::uint32_t mask = HIGH_BIT; mask != 0; mask >>= 1) {
+        if (lhs & mask) {
+            product ^= rhs;
+        }
+        rhs = (rhs & 1) ? (rhs >> 1) ^ POLYNOMIAL : rhs >> 1;
+    }
+    return product;
+}
+
+std::array<std::uint32_t, POWERS_COUNT> GeneratePowers() {
+    std::array<std::uint32_t, POWERS_COUNT> powers{};
+    powers[0] = HIGH_BIT >> 1;
+    for (std::size_t i = 1; i < POWERS_COUNT; ++i) {
+        powers[i] = MultiplyModulo(powers[i - 1], powers[i - 1]);
+    }
+    return powers;
+}
+
+const std::array<std::uint32_t, POWERS_COUNT> POWERS = GeneratePowers();
+
+std::uint32_t UpdateSoftware(std::uint32_t crc, std::span<const std::uint8_t> data) {
+    std::size_t i = 0;
+    for (; i + TABLES_COUNT <= data.size(); i += TABLES_COUNT) {
+        std::uint32_t low = crc ^ (static_cast<std::uint32_t>(data[i]) | (static_cast<std::uint32_t>(data[i + 1]) << 8) |
+                                   (static_cast<std::uint32_t>(data[i + 2]) << 16) |
+                                   (static_cast<std::uint32_t>(data[i + 3]) << 24));
+        crc = TABLE[7][low & 0xFF] ^ TABLE[6][(low >> 8) & 0xFF] ^ TABLE[5][(low >> 16) & 0xFF] ^
+              TABLE[4][low >> 24] ^ TABLE[3][data[i + 4]] ^ TABLE[2][data[i + 5]] ^ TABLE[1][data[i + 6]] ^
+              TABLE[0][data[i + 7]];
+    }
+    for (; i < data.size(); ++i) {
+        crc = (crc >> CHAR_BIT) ^ TABLE[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+
+bool HasHardwareCrc() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+const bool HARDWARE_CRC = HasHardwareCrc();
+
+std::uint64_t LoadWord(const std::uint8_t* data) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+__attribute__((target("sse4.2"))) std::uint32_t UpdateHardware(std::uint32_t crc, std::span<const std::uint8_t> data) {
+    std::uint64_t value = crc;
+    const std::uint8_t* pos = data.data();
+    const std::uint8_t* end = pos + data.size();
+    for (; pos + sizeof(std::uint64_t) <= end; pos += sizeof(std::uint64_t)) {
+        value = _mm_crc32_u64(value, LoadWord(pos));
+    }
+    crc = static_cast<std::uint32_t>(value);
+    for (; pos < end; ++pos) {
+        crc = _mm_crc32_u8(crc, *pos);
+    }
+    return crc;
+}
+
+// The instruction has a latency of three cycles, so three independent stripes keep it busy and are joined with
+// Crc32cCombine afterwards.
+__attribute__((target("sse4.2"))) std::array<std::uint32_t, 3> UpdateStripes(std::uint32_t crc,
+                                                                             const std::uint8_t* data) {
+    std::uint64_t first = crc;
+    std::uint64_t second = ~std::uint32_t{0};
+    std::uint64_t third = ~std::uint32_t{0};
+    for (std::size_t i = 0; i < STRIPE_SIZE; i += sizeof(std::uint64_t)) {
+        first = _mm_crc32_u64(first, LoadWord(data + i));
+        second = _mm_crc32_u64(second, LoadWord(data + STRIPE_SIZE + i));
+        third = _mm_crc32_u64(third, LoadWord(data + 2 * STRIPE_SIZE + i));
+    }
+    return {static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(second), static_cast<std::uint32_t>(third)};
+}
+
+#endif
+
+const std::size_t SHA256_BLOCK_SIZE = 64;
+const std::size_t SHA256_LENGTH_SIZE = sizeof(std::uint64_t);
+
+using Sha256State = std::array<std::uint32_t, 8>;
+
+const Sha256State SHA256_INITIAL = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                                    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+const std::array<std::uint32_t, SHA256_BLOCK_SIZE> SHA256_ROUNDS = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+void Sha256Block(Sha256State& state, const std::uint8_t* block) {
+    std::array<std::uint32_t, SHA256_BLOCK_SIZE> words{};
+    for (std::size_t i = 0; i < 16; ++i) {
+        words[i] = (static_cast<std::uint32_t>(block[4 * i]) << 24) |
+                   (static_cast<std::uint32_t>(block[4 * i + 1]) << 16) |
+                   (static_cast<std::uint32_t>(block[4 * i + 2]) << 8) | static_cast<std::uint32_t>(block[4 * i + 3]);
+    }
+    for (std::size_t i = 16; i < words.size(); ++i) {
+        std::uint32_t low = std::rotr(words[i - 15], 7) ^ std::rotr(words[i - 15], 18) ^ (words[i - 15] >> 3);
+        std::uint32_t high = std::rotr(words[i - 2], 17) ^ std::rotr(words[i - 2], 19) ^ (words[i - 2] >> 10);
+        words[i] = words[i - 16] + low + words[i - 7] + high;
+    }
+    auto [a, b, c, d, e, f, g, h] = state;
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        std::uint32_t first = h + (std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                              SHA256_ROUNDS[i] + words[i];
+        std::uint32_t second = (std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + first;
+        d = c;
+        c = b;
+        b = a;
+        a = first + second;
+    }
+    Sha256State rounds = {a, b, c, d, e, f, g, h};
+    for (std::size_t i = 0; i < state.size(); ++i) {
+        state[i] += rounds[i];
+    }
+}
+
+#if defined(__x86_64__)
+
+// The compiler runtime does not report the SHA extensions on every version, so the bit is read from cpuid.
+bool HasHardwareSha() {
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1") && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+
+const bool HARDWARE_SHA = HasHardwareSha();
+// The round instructions take four words at a time.
+const std::size_t WORD_GROUPS_COUNT = SHA256_BLOCK_SIZE / 4;
+
+// The state is kept as ABEF and CDGH halves, the order the round instructions take it in.
+__attribute__((target("sha,sse4.1"))) void Sha256BlocksHardware(Sha256State& state, const std::uint8_t* data,
+                                                                 std::size_t count) {
+    const __m128i byte_order = _mm_set_epi64x(0x0C0D0E0F08090A0B, 0x0405060700010203);
+    __m128i low = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+    __m128i high = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+    __m128i abef = _mm_alignr_epi8(low, high, 8);
+    __m128i cdgh = _mm_blend_epi16(high, low, 0xF0);
+    for (std::size_t block = 0; block < count; ++block, data += SHA256_BLOCK_SIZE) {
+        __m128i words[WORD_GROUPS_COUNT];
+        for (std::size_t i = 0; i < 4; ++i) {
+            words[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), byte_order);
+        }
+        for (std::size_t i = 4; i < WORD_GROUPS_COUNT; ++i) {
+            __m128i sum = _mm_add_epi32(_mm_sha256msg1_epu32(words[i - 4], words[i - 3]),
+                                        _mm_alignr_epi8(words[i - 1], words[i - 2], 4));
+            words[i] = _mm_sha256msg2_epu32(sum, words[i - 1]);
+        }
+        __m128i saved_abef = abef;
+        __m128i saved_cdgh = cdgh;
+        for (std::size_t i = 0; i < WORD_GROUPS_COUNT; ++i) {
+            __m128i message =
+                _mm_add_epi32(words[i], _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_ROUNDS[4 * i])));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+        }
+        abef = _mm_add_epi32(abef, saved_abef);
+        cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+    }
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#endif
+
+void Sha256Blocks(Sha256State& state, const std::uint8_t* data, std::size_t count) {
+#if defined(__x86_64__)
+    if (HARDWARE_SHA) {
+        Sha256BlocksHardware(state, data, count);
+        return;
+    }
+#endif
+    for (std::size_t i = 0; i < count; ++i) {
+        Sha256Block(state, data + i * SHA256_BLOCK_SIZE);
+    }
+}
+
+}  // namespace
+
+std::uint32_t Crc32c(std::span<const std::uint8_t> data, std::uint32_t crc) {
+#if defined(__x86_64__)
+    if (HARDWARE_CRC) {
+        for (; data.size() >= 3 * STRIPE_SIZE; data = data.subspan(3 * STRIPE_SIZE)) {
+            auto [first, second, third] = UpdateStripes(~crc, data.data());
+            crc = Crc32cCombine(Crc32cCombine(~first, ~second, STRIPE_SIZE), ~third, STRIPE_SIZE);
+        }
+        return ~UpdateHardware(~crc, data);
+    }
+#endif
+    return ~UpdateSoftware(~crc, data);
+}
+
+std::uint32_t Crc32cCombine(std::uint32_t first, std::uint32_t second, std::uint64_t second_size) {
+    std::uint32_t shift = HIGH_BIT;
+    for (std::size_t power = 3; second_size != 0; second_size >>= 1, ++power) {
+        if (second_size & 1) {
+            shift = MultiplyModulo(POWERS[power], shift);
+        }
+    }
+    return MultiplyModulo(shift, first) ^ second;
+}
+
+Sha256Digest Sha256(std::span<const std::uint8_t> data) {
+    Sha256State state = SHA256_INITIAL;
+    std::uint64_t length = static_cast<std::uint64_t>(data.size()) * CHAR_BIT;
+    std::size_t full_size = data.size() - data.size() % SHA256_BLOCK_SIZE;
+    Sha256Blocks(state, data.data(), full_size / SHA256_BLOCK_SIZE);
+    data = data.subspan(full_size);
+    // The rest is padded with a one bit, zeros and the length in bits, which takes one or two more blocks.
+    std::array<std::uint8_t, 2 * SHA256_BLOCK_SIZE> tail{};
+    std::copy(data.begin(), data.end(), tail.begin());
+    tail[data.size()] = 0x80;
+    std::size_t tail_size = data.size() + 1 + SHA256_LENGTH_SIZE <= SHA256_BLOCK_SIZE ? SHA256_BLOCK_SIZE : tail.size();
+    for (std::size_t i = 0; i < SHA256_LENGTH_SIZE; ++i) {
+        tail[tail_size - 1 - i] = static_cast<std::uint8_t>(length >> (CHAR_BIT * i));
+    }
+    Sha256Blocks(state, tail.data(), tail_size / SHA256_BLOCK_SIZE);
+    Sha256Digest digest{};
+    for (std::size_t i = 0; i < state.size(); ++i) {
+        for (std::size_t j = 0; j < sizeof(std::uint32_t); ++j) {
+            digest[sizeof(std::uint32_t) * i + j] = static_cast<std::uint8_t>(state[i] >> (CHAR_BIT * (3 - j)));
+        }
+    }
+    return digest;
+}
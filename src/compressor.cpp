@@ -1,116 +1,177 @@
 #include "compressor.h"
 
 #include <algorithm>
+#include <climits>
+#include <filesystem>
 #include <fstream>
 #include <functional>
 #include <memory>
 #include <string_view>
 
+#include "archive_format.h"
 #include "binary_trie.h"
+#include "block_compressor.h"
 #include "constants.h"
+#include "exceptions.h"
 #include "huffman.h"
+#include "input_source.h"
+#include "output_sink.h"
 #include "priority_queue.h"
-
-Compressor::Compressor(std::filesystem::path archive_name) : os_(archive_name, std::ios::binary), output_(os_) {
+#include "stats.h"
+
+Compressor::Compressor(std::filesystem::path archive_name, std::size_t max_code_size, std::size_t io_chunk_size,
+                       Stats* stats)
+    : os_(archive_name, std::ios::binary),
+      sink_(std::make_unique<StreamSink>(os_), io_chunk_size),
+      output_(sink_),
+      max_code_size_(max_code_size),
+      io_chunk_size_(io_chunk_size),
+      stats_(stats) {
 }
 
 void Compressor::Reset() {
     current_file_.clear();
-    symbols_count_.clear();
-    sizes_count_.clear();
-    codes_.clear();
-    alphabet_.clear();
-    max_size_ = 0;
+    symbols_count_.fill(0);
+    sizes_.clear();
+    codes_.fill({});
 }
 
-void Compressor::OpenFile(std::filesystem::path filename) {
-    current_file_ = filename.filename();
-    input_ = std::ifstream(filename, std::ios::binary);
+void Compressor::OpenFile(const InputFile& input) {
+    StageTimer timer(stats_, Stage::Open);
+    current_file_ = input.name;
+    input_ = OpenPrefetchSource(input.path, io_chunk_size_);
 }
 
 void Compressor::ResetPosition() {
-    input_.clear();
-    input_.seekg(0);
+    input_->Rewind();
 }
 
 void Compressor::CountSymbols() {
+    StageTimer timer(stats_, Stage::CountSymbols);
     symbols_count_[FILENAME_END] = 1;
     symbols_count_[ONE_MORE_FILE] = 1;
     symbols_count_[END_OF_ARCHIVE] = 1;
 
     for (char c : current_file_) {
-        ++symbols_count_[c];
+        ++symbols_count_[static_cast<std::uint8_t>(c)];
     }
 
-    while (!input_.eof()) {
-        unsigned char c = input_.get();
-        if (input_.eof()) {
-            break;
-        }
-        ++symbols_count_[c];
+    for (auto chunk = input_->Next(); !chunk.empty(); chunk = input_->Next()) {
+        CountBytes(chunk, symbols_count_);
     }
 }
 
 void Compressor::WriteSymbol(Char symbol) {
-    const auto& [code, size] = codes_[symbol];
-    output_.WriteBits(code, size);
+    output_.WriteWord(codes_[symbol].code, codes_[symbol].size);
 }
 
 void Compressor::WriteFile(bool is_last) {
-    WriteNumber(symbols_count_.size());
-    for (Char c : alphabet_) {
-        WriteNumber(c);
-    }
-    for (std::size_t size = 1; size <= max_size_; ++size) {
-        WriteNumber(sizes_count_[size]);
-    }
+    StageTimer timer(stats_, Stage::WriteFile);
+    WriteCodeSizes(output_, sizes_);
+    std::uint64_t start = output_.Position();
 
     for (char c : current_file_) {
-        WriteSymbol(c);
+        WriteSymbol(static_cast<std::uint8_t>(c));
     }
     WriteSymbol(FILENAME_END);
 
-    while (!input_.eof()) {
-        unsigned char c = input_.get();
-        if (input_.eof()) {
-            break;
-        }
-        WriteSymbol(c);
+    std::uint64_t size = 0;
+    for (auto chunk = input_->Next(); !chunk.empty(); chunk = input_->Next()) {
+        EncodeBuffer(output_, codes_, chunk);
+        size += chunk.size();
     }
     if (is_last) {
         WriteSymbol(END_OF_ARCHIVE);
     } else {
         WriteSymbol(ONE_MORE_FILE);
     }
+
+    if (STATS_ENABLED && stats_) {
+        ++stats_->files;
+        stats_->bytes_in += size;
+        stats_->symbols += current_file_.size() + size + 2;
+        stats_->code_bits += output_.Position() - start;
+        stats_->bytes_out = (output_.Position() + CHAR_BIT - 1) / CHAR_BIT;
+    }
 }
 
-void Compressor::CompressFile(Path filename, bool is_last) {
+void Compressor::CompressFile(const InputFile& input, bool is_last) {
     Reset();
-    OpenFile(filename);
+    OpenFile(input);
     CountSymbols();
 
-    auto sizes = HuffmanEncoding(symbols_count_);
-    alphabet_.reserve(sizes.size());
-    for (const auto& [key, size] : sizes) {
-        ++sizes_count_[size];
-        alphabet_.push_back(key);
-        max_size_ = size;
+    {
+        StageTimer timer(stats_, Stage::HuffmanEncoding);
+        sizes_ = LimitedHuffmanEncoding(symbols_count_, max_code_size_ == 0 ? MAX_CODE_SIZE : max_code_size_);
+    }
+    {
+        StageTimer timer(stats_, Stage::CanonicalCodes);
+        codes_ = CanonicalCodes(sizes_);
     }
-    codes_ = CanonicalCodes(sizes);
 
     ResetPosition();
     WriteFile(is_last);
+    if (is_last) {
+        output_.Flush();
+        sink_.Close();
+        if (!os_.flush()) {
+            throw OutputError();
+        }
+    }
 }
 
-void Compress(Path archive_name, const std::vector<Path>& filenames) {
-    Compressor compressor(archive_name);
-    for (std::size_t i = 0; i < filenames.size(); ++i) {
-        const auto& filename = filenames[i];
-        bool is_last = (i == filenames.size() - 1);
-        compressor.CompressFile(filename, is_last);
+void Compress(Path archive_name, const std::vector<Path>& filenames, const CompressOptions& options) {
+    std::vector<InputFile> inputs = CollectInputs(filenames, archive_name);
+    if (inputs.empty()) {
+        throw InputError();
+    }
+    if (options.format == ArchiveFormat::Blocks ||
+        !std::all_of(inputs.begin(), inputs.end(), [](const InputFile& input) { return IsSeekable(input.path); })) {
+        BlockCompressor compressor(archive_name, options);
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            compressor.CompressFile(inputs[i], i == inputs.size() - 1);
+        }
+        return;
+    }
+    Compressor compressor(archive_name, options.max_code_size, options.io_chunk_size, options.stats);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        bool is_last = (i == inputs.size() - 1);
+        compressor.CompressFile(inputs[i], is_last);
     }
 }
 
-void Compressor::WriteNumber(std::size_t number) {
-    output_.WriteBits(number, 9);
+void Append(Path archive_name, const std::vector<Path>& filenames, CompressOptions options) {
+    options.format = ArchiveFormat::Blocks;
+    if (!std::filesystem::exists(archive_name)) {
+        Compress(archive_name, filenames, options);
+        return;
+    }
+    if (DetectFormat(archive_name) != ArchiveFormat::Blocks) {
+        throw MissingDirectory();
+    }
+    std::vector<InputFile> inputs = CollectInputs(filenames, archive_name);
+    if (inputs.empty()) {
+        throw InputError();
+    }
+    AppendPoint point = ReadAppendPoint(RandomAccessFile::Open(archive_name));
+    // Drops what an append that did not finish left after the trailer.
+    if (point.archive_size < std::filesystem::file_size(archive_name)) {
+        std::filesystem::resize_file(archive_name, point.archive_size);
+    }
+    options.codec = point.header.codec;
+    bool writing = false;
+    try {
+        BlockCompressor compressor(archive_name, options, point);
+        writing = true;
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            compressor.CompressFile(inputs[i], i == inputs.size() - 1);
+        }
+    } catch (...) {
+        // The old members, directory and trailer are untouched, cutting off what was written after them restores
+        // the archive.
+        if (writing) {
+            std::filesystem::resize_file(archive_name, point.archive_size);
+        }
+        throw;
+    }
 }
@@ -0,0 +1,105 @@
+#include "decode_table.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "bit_stream.h"
+#include "constants.h"
+#include "huffman.h"
+
+DecodeTable::DecodeTable(const CodeTable& codes, std::size_t primary_bits) {
+    KeyedCodes sorted;
+    for (std::size_t key = 0; key < codes.size(); ++key) {
+        if (codes[key].size > 0) {
+            sorted.emplace_back(static_cast<Char>(key), codes[key]);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+        return std::pair(lhs.second.size, lhs.second.code) < std::pair(rhs.second.size, rhs.second.code);
+    });
+
+    const std::size_t max_size = sizeof(std::uint64_t) * CHAR_BIT;
+    std::uint64_t previous = 0;
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        const auto& [code, size] = sorted[i].second;
+        if (size > max_size || (size < max_size && (code >> size) != 0)) {
+            throw InvalidCode();
+        }
+        std::uint64_t aligned = static_cast<std::uint64_t>(code) << (max_size - size);
+        if (i > 0 && aligned <= previous) {
+            throw InvalidCode();
+        }
+        previous = aligned;
+    }
+
+    std::size_t longest = sorted.empty() ? 1 : sorted.back().second.size;
+    primary_bits_ = std::min(primary_bits, longest);
+    Build(sorted, 0, sorted.size(), AllocateTable(primary_bits_), primary_bits_, 0);
+}
+
+std::size_t DecodeTable::AllocateTable(std::size_t bits) {
+    std::size_t offset = entries_.size();
+    entries_.resize(offset + (std::size_t{1} << bits));
+    return offset;
+}
+
+void DecodeTable::Build(const KeyedCodes& codes, std::size_t begin, std::size_t end, std::size_t offset,
+                        std::size_t bits, std::size_t consumed) {
+    std::size_t i = begin;
+    for (; i < end && codes[i].second.size - consumed <= bits; ++i) {
+        const auto& [key, code] = codes[i];
+        std::size_t size = code.size - consumed;
+        std::size_t suffix = code.code & ((std::uint64_t{1} << size) - 1);
+        std::size_t first = offset + (suffix << (bits - size));
+        std::size_t last = first + (std::size_t{1} << (bits - size));
+        for (std::size_t j = first; j < last; ++j) {
+            entries_[j] = Entry{key, static_cast<std::uint8_t>(size), 0, 0};
+        }
+    }
+
+    while (i < end) {
+        auto prefix_of = [&](std::size_t index) {
+            const Code& code = codes[index].second;
+            return (code.code >> (code.size - consumed - bits)) & ((std::uint64_t{1} << bits) - 1);
+        };
+        std::size_t prefix = prefix_of(i);
+        std::size_t group_end = i;
+        std::size_t longest = 0;
+        while (group_end < end && prefix_of(group_end) == prefix) {
+            longest = std::max<std::size_t>(longest, codes[group_end].second.size);
+            ++group_end;
+        }
+
+        std::size_t table_bits = std::min(longest - consumed - bits, SECONDARY_BITS);
+        std::size_t table_offset = AllocateTable(table_bits);
+        entries_[offset + prefix] = Entry{0, 0, static_cast<std::uint8_t>(table_bits),
+                                          static_cast<std::uint32_t>(table_offset)};
+        Build(codes, i, group_end, table_offset, table_bits, consumed + bits);
+        i = group_end;
+    }
+}
+
+Char DecodeTable::Decode(BitReader& input) const {
+    std::size_t offset = 0;
+    std::size_t bits = primary_bits_;
+    while (true) {
+        const Entry& entry = entries_[offset + input.PeekBits(bits)];
+        if (entry.table_bits == 0) {
+            if (entry.size == 0) {
+                throw InvalidCode();
+            }
+            input.ConsumeBits(entry.size);
+            return entry.key;
+        }
+        input.ConsumeBits(bits);
+        offset = entry.table_offset;
+        bits = entry.table_bits;
+    }
+}
+
+std::size_t DecodeTable::Size() const {
+    return entries_.size();
+}
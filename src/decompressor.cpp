@@ -1,97 +1,124 @@
 #include "decompressor.h"
 
+#include <climits>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "archive_format.h"
 #include "binary_trie.h"
 #include "bit_stream.h"
+#include "block_decompressor.h"
 #include "constants.h"
 #include "exceptions.h"
 #include "files.h"
 #include "huffman.h"
+#include "input_source.h"
+#include "stats.h"
 
-Decompressor::Decompressor(Path filename) : is_(filename), input_(is_) {
+namespace {
+
+const std::size_t OUTPUT_BUFFER_SIZE = 1 << 16;
+
+}  // namespace
+
+Decompressor::Decompressor(Path filename, DecoderType decoder, OutputMode output_mode, std::size_t io_chunk_size,
+                           Stats* stats)
+    : source_(OpenPrefetchSource(filename, io_chunk_size)),
+      input_(*source_),
+      decoder_(decoder),
+      output_mode_(output_mode),
+      stats_(stats) {
+    buffer_.reserve(OUTPUT_BUFFER_SIZE);
 }
 
 void Decompressor::OpenFile(Path filename) {
-    if (!ValidateOutput(filename)) {
-        throw OutputError();
+    StageTimer timer(stats_, Stage::Open);
+    if (output_mode_ == OutputMode::StandardOutput) {
+        os_ = &std::cout;
+        return;
     }
-    os_ = std::ofstream(filename);
+    if (output_mode_ == OutputMode::Discard) {
+        os_ = nullptr;
+        return;
+    }
+    file_ = std::ofstream(PrepareOutput(filename.string()));
+    os_ = &file_;
 }
 
 void Decompressor::Reset() {
-    codes_.clear();
-    trie_ = std::make_shared<BinaryTrie>();
-}
-
-Char Decompressor::ReadNumber() {
-    Char number = 0;
-    try {
-        number = input_.ReadBits<Char>(9);
-    } catch (const BitReader::EndOfFile& ex) {
-        throw InvalidFormat();
-    }
-    if (number > 259) {
-        throw InvalidFormat();
-    }
-    return number;
+    codes_.fill({});
+    trie_.Clear();
+    table_.reset();
 }
 
 void Decompressor::ReadHeader() {
-    std::size_t count = ReadNumber();
-    std::vector<Char> alphabet(count);
-    for (Char& c : alphabet) {
-        c = ReadNumber();
-    }
-    std::size_t current = 0;
-    CodeSizes sizes(count);
-    for (std::size_t size = 1; current < count; ++size) {
-        std::size_t size_count = ReadNumber();
-        if (current + size_count > count) {
+    StageTimer timer(stats_, Stage::ReadHeader);
+    CodeSizes sizes = ReadCodeSizes(input_);
+    for (const auto& [key, size] : sizes) {
+        if (key > END_OF_ARCHIVE) {
             throw InvalidFormat();
         }
-        for (std::size_t i = 0; i < size_count; ++i, ++current) {
-            sizes[current] = {alphabet[current], size};
-        }
     }
     codes_ = CanonicalCodes(sizes);
 }
 
 void Decompressor::GenerateTrie() {
-    for (const auto& [key, code] : codes_) {
+    StageTimer timer(stats_, Stage::GenerateTrie);
+    for (std::size_t key = 0; key < codes_.size(); ++key) {
+        if (codes_[key].size == 0) {
+            continue;
+        }
         try {
-            trie_->AddCode(code.code, code.size, key);
+            trie_.AddCode(codes_[key].code, codes_[key].size, static_cast<Char>(key));
         } catch (const BinaryTrie::CodeAlreadyExists& ex) {
             throw InvalidFormat();
         }
     }
 }
 
-Char Decompressor::ReadSymbol(const BinaryTrie& node) {
-    if (node.IsTerminal()) {
-        return node.key_;
-    }
-    if (node.IsLeaf()) {
-        throw InvalidFormat();
-    }
-    bool bit = false;
+void Decompressor::GenerateTable() {
+    StageTimer timer(stats_, Stage::GenerateTable);
     try {
-        bit = input_.ReadBit();
-    } catch (const BitReader::EndOfFile& ex) {
+        table_.emplace(codes_);
+    } catch (const DecodeTable::InvalidCode& ex) {
         throw InvalidFormat();
     }
-    if (!bit) {
-        return ReadSymbol(node.CLeft());
-    } else {
-        return ReadSymbol(node.CRight());
+}
+
+Char Decompressor::ReadTrieSymbol() {
+    BinaryTrie::Index node = trie_.Root();
+    while (!trie_[node].IsTerminal()) {
+        bool bit = false;
+        try {
+            bit = input_.ReadBit();
+        } catch (const BitReader::EndOfFile& ex) {
+            throw InvalidFormat();
+        }
+        node = trie_.Child(node, bit);
+        if (node == BinaryTrie::NONE) {
+            throw InvalidFormat();
+        }
     }
+    return trie_[node].key;
 }
 
 Char Decompressor::ReadSymbol() {
-    return ReadSymbol(*trie_);
+    if (decoder_ == DecoderType::Trie) {
+        return ReadTrieSymbol();
+    }
+    try {
+        return table_->Decode(input_);
+    } catch (const DecodeTable::InvalidCode& ex) {
+        throw InvalidFormat();
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
 }
 
 std::string Decompressor::ReadFilename() {
@@ -112,27 +139,106 @@ bool Decompressor::DecompressFile() {
     Reset();
 
     ReadHeader();
-    GenerateTrie();
+    if (decoder_ == DecoderType::Trie) {
+        GenerateTrie();
+    } else {
+        GenerateTable();
+    }
 
-    Path filename = ReadFilename();
+    std::uint64_t start = input_.Position();
+    std::string filename = ReadFilename();
     OpenFile(filename);
 
-    while (true) {
+    std::uint64_t size = 0;
+    std::optional<Char> end;
+    while (!end) {
+        end = DecodeBuffer();
+        size += buffer_.size();
+        WriteBuffer();
+    }
+    if (os_ && !os_->flush()) {
+        throw OutputError();
+    }
+
+    if (STATS_ENABLED && stats_) {
+        ++stats_->files;
+        stats_->bytes_in = (input_.Position() + CHAR_BIT - 1) / CHAR_BIT;
+        stats_->bytes_out += size;
+        stats_->symbols += filename.size() + size + 2;
+        stats_->code_bits += input_.Position() - start;
+    }
+    return *end == ONE_MORE_FILE;
+}
+
+std::optional<Char> Decompressor::DecodeBuffer() {
+    StageTimer timer(stats_, Stage::Decode);
+    buffer_.clear();
+    while (buffer_.size() < OUTPUT_BUFFER_SIZE) {
         Char symbol = ReadSymbol();
         if (symbol == FILENAME_END) {
             throw InvalidFormat();
-        } else if (symbol == ONE_MORE_FILE) {
-            return true;
-        } else if (symbol == END_OF_ARCHIVE) {
-            return false;
-        } else {
-            os_.put(static_cast<char>(symbol));
+        } else if (symbol == ONE_MORE_FILE || symbol == END_OF_ARCHIVE) {
+            return symbol;
         }
+        buffer_.push_back(static_cast<char>(symbol));
     }
+    return std::nullopt;
 }
 
-void Decompress(Path archive_name) {
-    Decompressor decompressor(archive_name);
+void Decompressor::WriteBuffer() {
+    StageTimer timer(stats_, Stage::WriteOutput);
+    if (os_ && !os_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()))) {
+        throw OutputError();
+    }
+}
+
+namespace {
+
+void DecompressArchive(Path archive_name, const DecompressOptions& options, OutputMode output_mode) {
+    if (DetectFormat(archive_name) == ArchiveFormat::Blocks) {
+        if (options.threads_count > 1 && output_mode != OutputMode::StandardOutput) {
+            IndexedDecompressor decompressor(archive_name, options.threads_count, options.dictionary,
+                                             options.stats);
+            if (output_mode == OutputMode::Discard) {
+                decompressor.TestAll();
+            } else {
+                decompressor.DecompressAll();
+            }
+            return;
+        }
+        BlockDecompressor decompressor(archive_name, output_mode, options.dictionary, options.io_chunk_size,
+                                       options.stats);
+        while (decompressor.DecompressFile()) {
+        }
+        return;
+    }
+    Decompressor decompressor(archive_name, options.decoder, output_mode, options.io_chunk_size, options.stats);
     while (decompressor.DecompressFile()) {
     }
 }
+
+}  // namespace
+
+void Decompress(Path archive_name, const DecompressOptions& options) {
+    DecompressArchive(archive_name, options, options.standard_output ? OutputMode::StandardOutput : OutputMode::Files);
+}
+
+void Test(Path archive_name, const DecompressOptions& options) {
+    DecompressArchive(archive_name, options, OutputMode::Discard);
+}
+
+void Extract(Path archive_name, const std::vector<std::string>& names, const DecompressOptions& options) {
+    if (DetectFormat(archive_name) != ArchiveFormat::Blocks) {
+        throw MissingDirectory();
+    }
+    IndexedDecompressor decompressor(archive_name, options.threads_count, options.dictionary, options.stats);
+    decompressor.DecompressFiles(names);
+}
+
+void List(Path archive_name, std::ostream& os) {
+    if (DetectFormat(archive_name) != ArchiveFormat::Blocks) {
+        throw MissingDirectory();
+    }
+    IndexedDecompressor decompressor(archive_name, 1);
+    decompressor.List(os);
+}
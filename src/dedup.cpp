@@ -0,0 +1,76 @@
+#include "dedup.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <random>
+#include <utility>
+
+#include "checksum.h"
+
+namespace {
+
+const std::size_t GEAR_WINDOW = sizeof(std::uint64_t) * CHAR_BIT;
+const std::uint64_t CHUNK_MASK = ~std::uint64_t{0} << (GEAR_WINDOW - CHUNK_BITS);
+
+using GearTable = std::array<std::uint64_t, 1 << CHAR_BIT>;
+
+GearTable GenerateGear() {
+    GearTable gear{};
+    std::mt19937_64 generator(GEAR_WINDOW);
+    for (auto& value : gear) {
+        value = generator();
+    }
+    return gear;
+}
+
+const GearTable GEAR = GenerateGear();
+
+}  // namespace
+
+std::size_t FindChunkEnd(std::span<const std::uint8_t> data, std::size_t max_size) {
+    std::size_t end = std::min(data.size(), max_size);
+    std::size_t min_size = std::min(MIN_CHUNK_SIZE, end);
+    std::uint64_t hash = 0;
+    // The top bits of the gear hash depend on the last GEAR_WINDOW bytes, warm it up on those before the minimum.
+    for (std::size_t i = min_size - std::min(min_size, GEAR_WINDOW); i < min_size; ++i) {
+        hash = (hash << 1) + GEAR[data[i]];
+    }
+    for (std::size_t i = min_size; i < end; ++i) {
+        hash = (hash << 1) + GEAR[data[i]];
+        if ((hash & CHUNK_MASK) == 0) {
+            return i + 1;
+        }
+    }
+    return end;
+}
+
+std::vector<std::size_t> FindChunks(std::span<const std::uint8_t> data, std::size_t max_size) {
+    std::vector<std::size_t> chunks;
+    while (!data.empty()) {
+        std::size_t size = FindChunkEnd(data, max_size);
+        chunks.push_back(size);
+        data = data.subspan(size);
+    }
+    return chunks;
+}
+
+ChunkKey MakeChunkKey(std::span<const std::uint8_t> data) {
+    return {Sha256(data), static_cast<std::uint32_t>(data.size())};
+}
+
+bool ChunkIndex::Contains(const ChunkKey& key) const {
+    std::lock_guard lock(mutex_);
+    return blocks_.contains(key);
+}
+
+const std::vector<BlockEntry>* ChunkIndex::Find(const ChunkKey& key) const {
+    std::lock_guard lock(mutex_);
+    auto blocks = blocks_.find(key);
+    return blocks == blocks_.end() ? nullptr : &blocks->second;
+}
+
+void ChunkIndex::Insert(const ChunkKey& key, std::vector<BlockEntry> blocks) {
+    std::lock_guard lock(mutex_);
+    blocks_.emplace(key, std::move(blocks));
+}
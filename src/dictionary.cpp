@@ -0,0 +1,90 @@
+#include "dictionary.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <span>
+
+#include "bit_stream.h"
+#include "checksum.h"
+#include "exceptions.h"
+#include "input_source.h"
+#include "output_sink.h"
+
+namespace {
+
+const std::size_t BYTE_VALUES = 1 << CHAR_BIT;
+
+std::vector<std::uint8_t> EncodeSizes(const CodeSizes& sizes) {
+    std::vector<std::uint8_t> data;
+    MemorySink sink(data);
+    BitWriter output(sink);
+    WriteCompactCodeSizes(output, sizes);
+    output.Flush();
+    return data;
+}
+
+std::uint32_t DictionaryId(std::span<const std::uint8_t> encoded_sizes) {
+    return std::max<std::uint32_t>(Crc32c(encoded_sizes), 1);
+}
+
+}  // namespace
+
+Dictionary TrainDictionary(const std::vector<Path>& samples) {
+    SymbolsCount symbols_count{};
+    std::fill_n(symbols_count.begin(), BYTE_VALUES, 1);
+    for (const Path& sample : samples) {
+        auto input = OpenSource(sample);
+        for (auto chunk = input->Next(); !chunk.empty(); chunk = input->Next()) {
+            CountBytes(chunk, symbols_count);
+        }
+    }
+    Dictionary dictionary;
+    dictionary.sizes = LimitedHuffmanEncoding(symbols_count);
+    dictionary.id = DictionaryId(EncodeSizes(dictionary.sizes));
+    return dictionary;
+}
+
+void SaveDictionary(Path filename, const Dictionary& dictionary) {
+    std::ofstream os(filename, std::ios::binary);
+    BitWriter output(os);
+    output.WriteBytes(DICTIONARY_MAGIC);
+    output.WriteBits(DICTIONARY_VERSION, CHAR_BIT);
+    output.WriteBytes(EncodeSizes(dictionary.sizes));
+    output.Flush();
+    if (!os.flush()) {
+        throw OutputError();
+    }
+}
+
+Dictionary LoadDictionary(Path filename) {
+    std::ifstream is(filename, std::ios::binary);
+    if (!is) {
+        throw InputError();
+    }
+    std::vector<std::uint8_t> data(std::istreambuf_iterator<char>(is), {});
+    std::size_t header_size = DICTIONARY_MAGIC.size() + 1;
+    if (data.size() < header_size || !std::equal(DICTIONARY_MAGIC.begin(), DICTIONARY_MAGIC.end(), data.begin()) ||
+        data[DICTIONARY_MAGIC.size()] != DICTIONARY_VERSION) {
+        throw InvalidDictionary();
+    }
+    std::span<const std::uint8_t> encoded_sizes = std::span(data).subspan(header_size);
+
+    Dictionary dictionary;
+    try {
+        MemorySource source(encoded_sizes);
+        BitReader input(source);
+        dictionary.sizes = ReadCompactCodeSizes(input);
+    } catch (const InvalidFormat& ex) {
+        throw InvalidDictionary();
+    }
+    if (dictionary.sizes.size() != BYTE_VALUES ||
+        std::any_of(dictionary.sizes.begin(), dictionary.sizes.end(),
+                    [](const CodeSize& size) { return static_cast<std::size_t>(size.key) >= BYTE_VALUES; })) {
+        throw InvalidDictionary();
+    }
+    dictionary.id = DictionaryId(encoded_sizes);
+    return dictionary;
+}
@@ -1,9 +1,142 @@
 #include "files.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <system_error>
+#include <utility>
+
+#include "exceptions.h"
+
 bool ValidateOutput(Path archive_name) {
     return !std::filesystem::is_directory(archive_name);
 }
 
 bool ValidateInput(Path filename) {
-    return std::filesystem::exists(filename) && !std::filesystem::is_directory(filename);
+    return filename == STANDARD_STREAM ||
+           (std::filesystem::exists(filename) && !std::filesystem::is_directory(filename));
+}
+
+bool IsSeekable(Path filename) {
+    return filename != STANDARD_STREAM && std::filesystem::is_regular_file(filename);
+}
+
+std::vector<InputFile> CollectInputs(const std::vector<Path>& paths, Path archive_name) {
+    std::vector<InputFile> inputs;
+    for (const Path& path : paths) {
+        if (path == STANDARD_STREAM || !std::filesystem::is_directory(path)) {
+            inputs.push_back({path, path == STANDARD_STREAM ? path.string() : path.filename().string()});
+            continue;
+        }
+        Path root = std::filesystem::absolute(path).lexically_normal();
+        if (!root.has_filename()) {
+            root = root.parent_path();
+        }
+        Path base = root.parent_path();
+        std::vector<InputFile> files;
+        try {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+                std::error_code error;
+                if (entry.is_regular_file() &&
+                    (archive_name.empty() || !std::filesystem::equivalent(entry.path(), archive_name, error))) {
+                    files.push_back({entry.path(), entry.path().lexically_relative(base).generic_string()});
+                }
+            }
+        } catch (const std::filesystem::filesystem_error& ex) {
+            throw InputError();
+        }
+        std::sort(files.begin(), files.end(), [](const InputFile& lhs, const InputFile& rhs) {
+            return lhs.name < rhs.name;
+        });
+        inputs.insert(inputs.end(), files.begin(), files.end());
+    }
+    return inputs;
+}
+
+Path PrepareOutput(const std::string& name) {
+    Path path(name);
+    if (name.empty() || path.has_root_path() ||
+        std::any_of(path.begin(), path.end(), [](const Path& part) { return part == ".."; })) {
+        throw UnsafePath();
+    }
+    if (path.has_parent_path()) {
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+        if (error) {
+            throw OutputError();
+        }
+    }
+    if (!ValidateOutput(path)) {
+        throw OutputError();
+    }
+    return path;
+}
+
+RandomAccessFile::RandomAccessFile(int fd) : fd_(fd) {
+}
+
+RandomAccessFile RandomAccessFile::Open(Path filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw InputError();
+    }
+    return RandomAccessFile(fd);
+}
+
+RandomAccessFile RandomAccessFile::Create(Path filename, std::uint64_t size) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw OutputError();
+    }
+    RandomAccessFile file(fd);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        throw OutputError();
+    }
+    return file;
+}
+
+RandomAccessFile::RandomAccessFile(RandomAccessFile&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {
+}
+
+RandomAccessFile& RandomAccessFile::operator=(RandomAccessFile&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+}
+
+RandomAccessFile::~RandomAccessFile() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void RandomAccessFile::ReadAt(std::span<std::uint8_t> data, std::uint64_t offset) const {
+    while (!data.empty()) {
+        ssize_t count = pread(fd_, data.data(), data.size(), static_cast<off_t>(offset));
+        if (count <= 0) {
+            throw InputError();
+        }
+        data = data.subspan(count);
+        offset += count;
+    }
+}
+
+void RandomAccessFile::WriteAt(std::span<const std::uint8_t> data, std::uint64_t offset) const {
+    while (!data.empty()) {
+        ssize_t count = pwrite(fd_, data.data(), data.size(), static_cast<off_t>(offset));
+        if (count <= 0) {
+            throw OutputError();
+        }
+        data = data.subspan(count);
+        offset += count;
+    }
+}
+
+std::uint64_t RandomAccessFile::Size() const {
+    struct stat info {};
+    if (fstat(fd_, &info) != 0) {
+        throw InputError();
+    }
+    return static_cast<std::uint64_t>(info.st_size);
 }
@@ -1,44 +1,283 @@
 #include "huffman.h"
 
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <limits>
 #include <tuple>
+#include <utility>
 
 #include "binary_trie.h"
+#include "bit_stream.h"
+#include "exceptions.h"
 #include "priority_queue.h"
 
-bool PointerCompare(const BinaryTrie::Pointer& lhs, const BinaryTrie::Pointer& rhs) {
-    return *lhs > *rhs;
+namespace {
+
+const std::size_t NUMBER_BITS = 9;
+const Char MAX_NUMBER = ALPHABET_SIZE;
+const std::size_t LEAF = std::numeric_limits<std::size_t>::max();
+
+const std::size_t BYTE_VALUES = 1 << CHAR_BIT;
+const std::size_t HISTOGRAM_TABLES = 4;
+const std::size_t HISTOGRAM_SLICE = 1 << 30;
+
+using Histogram = std::array<std::array<std::uint32_t, BYTE_VALUES>, HISTOGRAM_TABLES>;
+
+void CountSlice(const std::uint8_t* data, std::size_t size, Histogram& tables) {
+    std::size_t i = 0;
+    for (; i + 2 * sizeof(std::uint64_t) <= size; i += 2 * sizeof(std::uint64_t)) {
+        std::uint64_t first = 0;
+        std::uint64_t second = 0;
+        std::memcpy(&first, data + i, sizeof(first));
+        std::memcpy(&second, data + i + sizeof(first), sizeof(second));
+        for (std::size_t shift = 0; shift < sizeof(std::uint64_t) * CHAR_BIT; shift += 2 * CHAR_BIT) {
+            ++tables[0][(first >> shift) & 0xFF];
+            ++tables[1][(first >> (shift + CHAR_BIT)) & 0xFF];
+            ++tables[2][(second >> shift) & 0xFF];
+            ++tables[3][(second >> (shift + CHAR_BIT)) & 0xFF];
+        }
+    }
+    for (; i < size; ++i) {
+        ++tables[i % HISTOGRAM_TABLES][data[i]];
+    }
+}
+
+struct MergeNode {
+    std::size_t count;
+    Char key;
+    std::size_t index;
+
+    bool operator<(const MergeNode& other) const {
+        return std::tie(count, key) < std::tie(other.count, other.key);
+    }
+};
+
+struct MergeItem {
+    std::size_t weight;
+    std::size_t left;
+    std::size_t right;
+};
+
+template <typename Emit>
+void EmitCompactCodeSizes(const CodeSizes& sizes, Emit emit) {
+    std::array<std::size_t, ALPHABET_SIZE> lengths{};
+    std::size_t count = 0;
+    for (const auto& [key, size] : sizes) {
+        lengths[key] = size;
+        count = std::max<std::size_t>(count, key + 1);
+    }
+    emit(count, NUMBER_BITS);
+    std::size_t previous = 0;
+    for (std::size_t key = 0; key < count;) {
+        std::size_t run = 0;
+        while (key + run < count && lengths[key + run] == previous) {
+            ++run;
+        }
+        if (run > 0) {
+            std::size_t run_bits = std::bit_width(run);
+            emit(0, run_bits);
+            emit(run, run_bits);
+            key += run;
+            continue;
+        }
+        std::size_t length = lengths[key];
+        if (length == previous + 1 || length + 1 == previous) {
+            emit(0b100 | (length > previous), 3);
+        } else {
+            emit(0b11, 2);
+            emit(length, CODE_LENGTH_BITS);
+        }
+        previous = length;
+        ++key;
+    }
+}
+
+Char ReadNumber(BitReader& input) {
+    Char number = 0;
+    try {
+        number = input.ReadBits<Char>(NUMBER_BITS);
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+    if (number > MAX_NUMBER) {
+        throw InvalidFormat();
+    }
+    return number;
+}
+
+}  // namespace
+
+void CountBytes(std::span<const std::uint8_t> data, SymbolsCount& symbols_count) {
+    while (!data.empty()) {
+        std::size_t size = std::min(data.size(), HISTOGRAM_SLICE);
+        Histogram tables{};
+        CountSlice(data.data(), size, tables);
+        for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+            symbols_count[c] += tables[0][c] + tables[1][c] + tables[2][c] + tables[3][c];
+        }
+        data = data.subspan(size);
+    }
 }
 
 CodeSizes HuffmanEncoding(const SymbolsCount& symbols_count) {
-    PriorityQueue<BinaryTrie::Pointer, decltype(PointerCompare)*> queue(PointerCompare);
+    std::vector<MergeNode> leaves;
+    for (std::size_t key = 0; key < symbols_count.size(); ++key) {
+        if (symbols_count[key] > 0) {
+            leaves.push_back({symbols_count[key], static_cast<Char>(key), 0});
+        }
+    }
+    std::sort(leaves.begin(), leaves.end());
+    std::size_t leaves_count = leaves.size();
+    if (leaves_count == 0) {
+        return {};
+    } else if (leaves_count == 1) {
+        return {CodeSize{leaves[0].key, 1}};
+    }
+    for (std::size_t i = 0; i < leaves_count; ++i) {
+        leaves[i].index = i;
+    }
+
+    std::vector<std::size_t> parent(2 * leaves_count - 1);
+    std::vector<MergeNode> nodes;
+    nodes.reserve(leaves_count - 1);
+    std::size_t leaf = 0;
+    std::size_t front = 0;
+    auto pop = [&]() {
+        if (leaf < leaves_count && (front == nodes.size() || leaves[leaf] < nodes[front])) {
+            return leaves[leaf++];
+        }
+        return nodes[front++];
+    };
+    for (std::size_t index = leaves_count; index < parent.size(); ++index) {
+        MergeNode left = pop();
+        MergeNode right = pop();
+        parent[left.index] = index;
+        parent[right.index] = index;
+        MergeNode node{left.count + right.count, std::min(left.key, right.key), index};
+        std::size_t position = nodes.size();
+        nodes.push_back(node);
+        for (; position > front && node < nodes[position - 1]; --position) {
+            nodes[position] = nodes[position - 1];
+        }
+        nodes[position] = node;
+    }
+
+    std::vector<std::size_t> depth(parent.size());
+    for (std::size_t index = parent.size() - 1; index-- > 0;) {
+        depth[index] = depth[parent[index]] + 1;
+    }
+    CodeSizes sizes;
+    sizes.reserve(leaves_count);
+    for (std::size_t i = 0; i < leaves_count; ++i) {
+        sizes.push_back(CodeSize{leaves[i].key, depth[i]});
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return sizes;
+}
+
+CodeSizes TreeHuffmanEncoding(const SymbolsCount& symbols_count) {
+    BinaryTrie trie;
+    trie.Reserve(2 * symbols_count.size());
+    auto compare = [&trie](BinaryTrie::Index lhs, BinaryTrie::Index rhs) { return trie[lhs] > trie[rhs]; };
+    PriorityQueue<BinaryTrie::Index, decltype(compare)> queue(compare);
     queue.Reserve(symbols_count.size());
 
-    for (const auto& [key, count] : symbols_count) {
-        queue.Push(std::make_shared<BinaryTrie>(key, count));
+    for (std::size_t key = 0; key < symbols_count.size(); ++key) {
+        if (symbols_count[key] > 0) {
+            queue.Push(trie.AddLeaf(static_cast<Char>(key), symbols_count[key]));
+        }
     }
+    std::size_t leaves_count = queue.Size();
 
     while (queue.Size() > 1) {
-        BinaryTrie::Pointer left = queue.Top();
+        BinaryTrie::Index left = queue.Top();
         queue.Pop();
-        BinaryTrie::Pointer right = queue.Top();
+        BinaryTrie::Index right = queue.Top();
         queue.Pop();
-        BinaryTrie::Pointer node = std::make_shared<BinaryTrie>(left, right);
-        queue.Push(node);
+        queue.Push(trie.AddNode(left, right));
     }
-    BinaryTrie::Pointer root = queue.Top();
+    BinaryTrie::Index root = queue.Top();
     queue.Pop();
 
     CodeSizes sizes;
-    sizes.reserve(symbols_count.size());
-    auto callback = [&](std::size_t, std::size_t size, Char key) { sizes.push_back(CodeSize{key, size}); };
-    root->Traverse(callback);
+    sizes.reserve(leaves_count);
+    auto callback = [&](std::size_t, std::size_t size, Char key) {
+        sizes.push_back(CodeSize{key, std::max<std::size_t>(size, 1)});
+    };
+    trie.Traverse(root, callback);
     std::sort(sizes.begin(), sizes.end());
 
     return sizes;
-};
+}
+
+CodeSizes LimitedHuffmanEncoding(const SymbolsCount& symbols_count, std::size_t max_size) {
+    CodeSizes sizes = HuffmanEncoding(symbols_count);
+    if (sizes.empty() || sizes.back().size <= max_size) {
+        return sizes;
+    }
+
+    std::vector<std::pair<std::size_t, Char>> leaves;
+    leaves.reserve(sizes.size());
+    for (std::size_t key = 0; key < symbols_count.size(); ++key) {
+        if (symbols_count[key] > 0) {
+            leaves.emplace_back(symbols_count[key], static_cast<Char>(key));
+        }
+    }
+    std::sort(leaves.begin(), leaves.end());
+    max_size = std::max<std::size_t>(max_size, std::bit_width(leaves.size() - 1));
+
+    std::vector<std::vector<MergeItem>> levels(max_size);
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        levels[0].push_back({leaves[i].first, i, LEAF});
+    }
+    for (std::size_t level = 1; level < max_size; ++level) {
+        const std::vector<MergeItem>& previous = levels[level - 1];
+        std::vector<MergeItem>& current = levels[level];
+        current.reserve(leaves.size() + previous.size() / 2);
+        std::size_t leaf = 0;
+        std::size_t package = 0;
+        while (leaf < leaves.size() || package + 1 < previous.size()) {
+            bool has_package = package + 1 < previous.size();
+            std::size_t package_weight = has_package ? previous[package].weight + previous[package + 1].weight : 0;
+            if (leaf < leaves.size() && (!has_package || leaves[leaf].first <= package_weight)) {
+                current.push_back({leaves[leaf].first, leaf, LEAF});
+                ++leaf;
+            } else {
+                current.push_back({package_weight, package, package + 1});
+                package += 2;
+            }
+        }
+    }
+
+    std::vector<std::size_t> lengths(leaves.size());
+    std::vector<std::pair<std::size_t, std::size_t>> stack;
+    for (std::size_t i = 0; i < 2 * leaves.size() - 2; ++i) {
+        stack.emplace_back(max_size - 1, i);
+    }
+    while (!stack.empty()) {
+        auto [level, index] = stack.back();
+        stack.pop_back();
+        const MergeItem& item = levels[level][index];
+        if (item.right == LEAF) {
+            ++lengths[item.left];
+        } else {
+            stack.emplace_back(level - 1, item.left);
+            stack.emplace_back(level - 1, item.right);
+        }
+    }
+
+    sizes.clear();
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+        sizes.push_back(CodeSize{leaves[i].second, lengths[i]});
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return sizes;
+}
 
 CodeTable CanonicalCodes(const CodeSizes& sizes) {
-    CodeTable codes;
+    CodeTable codes{};
 
     std::size_t current_code = 0;
     std::size_t current_size = 1;
@@ -54,6 +293,119 @@ CodeTable CanonicalCodes(const CodeSizes& sizes) {
     return codes;
 }
 
+void EncodeBuffer(BitWriter& output, const CodeTable& codes, std::span<const std::uint8_t> data) {
+    for (std::uint8_t c : data) {
+        const Code& code = codes[c];
+        output.WriteWord(code.code, code.size);
+    }
+}
+
+void WriteCodeSizes(BitWriter& output, const CodeSizes& sizes) {
+    output.WriteBits(sizes.size(), NUMBER_BITS);
+    for (const auto& [key, size] : sizes) {
+        output.WriteBits(key, NUMBER_BITS);
+    }
+    std::size_t current = 0;
+    for (std::size_t size = 1; current < sizes.size(); ++size) {
+        std::size_t size_count = 0;
+        while (current < sizes.size() && sizes[current].size == size) {
+            ++size_count;
+            ++current;
+        }
+        output.WriteBits(size_count, NUMBER_BITS);
+    }
+}
+
+CodeSizes ReadCodeSizes(BitReader& input) {
+    std::size_t count = ReadNumber(input);
+    std::vector<Char> alphabet(count);
+    for (Char& c : alphabet) {
+        c = ReadNumber(input);
+        if (static_cast<std::size_t>(c) >= ALPHABET_SIZE) {
+            throw InvalidFormat();
+        }
+    }
+    std::size_t current = 0;
+    CodeSizes sizes(count);
+    for (std::size_t size = 1; current < count; ++size) {
+        if (size > MAX_CODE_SIZE) {
+            throw InvalidFormat();
+        }
+        std::size_t size_count = ReadNumber(input);
+        if (current + size_count > count) {
+            throw InvalidFormat();
+        }
+        for (std::size_t i = 0; i < size_count; ++i, ++current) {
+            sizes[current] = {alphabet[current], size};
+        }
+    }
+    return sizes;
+}
+
 bool CodeSize::operator<(const CodeSize& other) const {
     return std::tie(size, key) < std::tie(other.size, other.key);
 }
+
+std::size_t EncodedBits(const SymbolsCount& symbols_count, std::size_t max_size) {
+    CodeSizes sizes = LimitedHuffmanEncoding(symbols_count, max_size);
+    std::size_t bits = 0;
+    EmitCompactCodeSizes(sizes, [&bits](std::size_t, std::size_t count) { bits += count; });
+    for (const auto& [key, size] : sizes) {
+        bits += symbols_count[key] * size;
+    }
+    return bits;
+}
+
+void WriteCompactCodeSizes(BitWriter& output, const CodeSizes& sizes) {
+    EmitCompactCodeSizes(sizes, [&output](std::size_t data, std::size_t count) { output.WriteBits(data, count); });
+}
+
+CodeSizes ReadCompactCodeSizes(BitReader& input) {
+    std::size_t count = ReadNumber(input);
+    CodeSizes sizes;
+    try {
+        std::size_t previous = 0;
+        for (std::size_t key = 0; key < count;) {
+            if (!input.ReadBit()) {
+                std::size_t run_bits = 1;
+                while (!input.ReadBit()) {
+                    if (++run_bits > NUMBER_BITS) {
+                        throw InvalidFormat();
+                    }
+                }
+                std::size_t run = (std::size_t{1} << (run_bits - 1)) | input.ReadBits<std::size_t>(run_bits - 1);
+                if (run > count - key) {
+                    throw InvalidFormat();
+                }
+                for (std::size_t end = key + run; key < end; ++key) {
+                    if (previous > 0) {
+                        sizes.push_back({static_cast<Char>(key), previous});
+                    }
+                }
+                continue;
+            }
+            std::size_t length = 0;
+            if (!input.ReadBit()) {
+                bool up = input.ReadBit();
+                if (!up && previous == 0) {
+                    throw InvalidFormat();
+                }
+                length = up ? previous + 1 : previous - 1;
+            } else {
+                length = input.ReadBits<std::size_t>(CODE_LENGTH_BITS);
+            }
+            if (length > MAX_CODE_SIZE) {
+                throw InvalidFormat();
+            }
+            if (length > 0) {
+                sizes.push_back({static_cast<Char>(key), length});
+            }
+            previous = length;
+            ++key;
+        }
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+    std::sort(sizes.begin(), sizes.end());
+    return sizes;
+}
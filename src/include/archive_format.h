@@ -0,0 +1,104 @@
+#ifndef ARCHIVER_ARCHIVE_FORMAT_
+#define ARCHIVER_ARCHIVE_FORMAT_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bit_stream.h"
+#include "files.h"
+#include "stats.h"
+
+enum class ArchiveFormat { Legacy, Blocks };
+enum class CodecId : std::uint8_t { Huffman, Rans, Lz77 };
+
+const std::array<std::uint8_t, 4> ARCHIVE_MAGIC = {0x00, 'A', 'R', 'C'};
+const std::array<std::uint8_t, 4> DIRECTORY_MAGIC = {'A', 'D', 'I', 'R'};
+const std::uint8_t ARCHIVE_VERSION = 7;
+
+const std::size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+const std::size_t MAX_BLOCK_SIZE = 1 << 30;
+const std::size_t MAX_NAME_SIZE = (1 << 16) - 1;
+const std::string STANDARD_INPUT_NAME = "stdin";
+const std::size_t MAX_HEADER_SIZE = 1 << 10;
+const std::size_t NAME_SIZE_BITS = 16;
+const std::size_t BLOCK_SIZE_BITS = 32;
+const std::size_t COUNT_BITS = 32;
+const std::size_t OFFSET_BITS = 64;
+const std::size_t CHECKSUM_BITS = 32;
+const std::size_t DICTIONARY_ID_BITS = 32;
+const std::size_t ARCHIVE_HEADER_SIZE = ARCHIVE_MAGIC.size() + 2 + DICTIONARY_ID_BITS / 8;
+const std::size_t TRAILER_SIZE = OFFSET_BITS / 8 + DIRECTORY_MAGIC.size();
+const std::size_t BLOCK_OVERHEAD_BITS = 4 * BLOCK_SIZE_BITS + 2 * OFFSET_BITS + 2 * CHECKSUM_BITS;
+const std::uint64_t SHARED_TABLE_FLAG = std::uint64_t{1} << (BLOCK_SIZE_BITS - 1);
+// A block with an empty payload repeats an earlier block, the offset and size of that block's payload follow it.
+const std::size_t REFERENCE_PAYLOAD_SIZE = 0;
+
+struct CompressOptions {
+    ArchiveFormat format = ArchiveFormat::Legacy;
+    std::size_t threads_count = 1;
+    std::size_t block_size = DEFAULT_BLOCK_SIZE;
+    std::size_t max_code_size = 0;
+    CodecId codec = CodecId::Huffman;
+    std::size_t level = 0;
+    std::size_t window_bits = 0;
+    bool adaptive = false;
+    bool solid = false;
+    bool dedup = false;
+    Path dictionary;
+    std::size_t io_chunk_size = 0;
+    Stats* stats = nullptr;
+};
+
+struct ArchiveHeader {
+    CodecId codec = CodecId::Huffman;
+    std::uint32_t dictionary_id = 0;
+};
+
+struct BlockEntry {
+    std::uint64_t payload_offset = 0;
+    std::uint64_t payload_size = 0;
+    std::uint64_t raw_size = 0;
+    std::uint64_t output_offset = 0;
+    bool shared_table = false;
+    std::uint32_t checksum = 0;
+};
+
+struct MemberEntry {
+    std::string name;
+    std::uint64_t header_offset = 0;
+    std::uint64_t compressed_size = 0;
+    std::uint64_t size = 0;
+    std::uint32_t checksum = 0;
+    std::vector<BlockEntry> blocks;
+};
+
+using ArchiveDirectory = std::vector<MemberEntry>;
+
+// New members go after the trailer of a block archive and are followed by a directory of all members, so the archive
+// is left as it was until the new trailer is written. The size is where that trailer ends.
+struct AppendPoint {
+    ArchiveHeader header;
+    ArchiveDirectory directory;
+    std::uint64_t archive_size = 0;
+};
+
+ArchiveFormat DetectFormat(Path archive_name);
+// Coders spend at most MAX_CODE_SIZE bits per byte plus their tables.
+std::size_t MaxPayloadSize(std::size_t raw_size);
+
+void WriteArchiveHeader(BitWriter& output, const ArchiveHeader& header = {});
+ArchiveHeader ReadArchiveHeader(BitReader& input);
+ArchiveHeader ReadArchiveHeader(const RandomAccessFile& archive);
+
+void WriteArchiveDirectory(BitWriter& output, const ArchiveDirectory& directory);
+ArchiveDirectory ReadArchiveDirectory(BitReader& input, std::uint64_t directory_offset);
+// An append that did not finish leaves part of its members after the last trailer, the archive then ends at that
+// trailer.
+std::uint64_t FindArchiveEnd(const RandomAccessFile& archive);
+ArchiveDirectory ReadArchiveDirectory(const RandomAccessFile& archive);
+AppendPoint ReadAppendPoint(const RandomAccessFile& archive);
+
+#endif  // ARCHIVER_ARCHIVE_FORMAT_
@@ -14,20 +14,23 @@ class ArgumentParser {
 public:
     struct ParsedArguments {
         std::unordered_set<std::string> options;
+        std::unordered_map<std::string, std::string> values;
         std::vector<std::string> positional_arguments;
     };
 
     struct OptionData {
         std::string description;
         std::string usage;
+        bool has_value = false;
 
         OptionData();
-        OptionData(std::string_view description, std::string_view usage);
+        OptionData(std::string_view description, std::string_view usage, bool has_value = false);
     };
 
     explicit ArgumentParser(std::string_view program_name);
 
-    void AddOption(std::string_view name, std::string_view description, std::string_view usage) noexcept;
+    void AddOption(std::string_view name, std::string_view description, std::string_view usage,
+                   bool has_value = false) noexcept;
     ParsedArguments ParseArguments(int argc, char** argv) const;
     void PrintUsage() const noexcept;
 
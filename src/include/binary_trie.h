@@ -3,52 +3,56 @@
 
 #include <compare>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <limits>
-#include <memory>
+#include <vector>
 
 #include "constants.h"
 
 class BinaryTrie {
-    const static BinaryTrie DEFAULT_VALUE;
-
 public:
     class CodeAlreadyExists : public std::exception {};
 
+    using Index = std::uint32_t;
     using Callback = std::function<void(std::size_t, std::size_t, Char)>;
-    using Pointer = std::shared_ptr<BinaryTrie>;
 
-    BinaryTrie();
-    BinaryTrie(Char key, std::size_t count);
-    BinaryTrie(Pointer left, Pointer right);
+    const static Index NONE = std::numeric_limits<Index>::max();
 
-    std::strong_ordering operator<=>(const BinaryTrie& other) const;
+    struct Node {
+        std::size_t count = 0;
+        Char key = std::numeric_limits<Char>::max();
+        bool terminal = false;
+        Index left = NONE;
+        Index right = NONE;
 
-    bool IsTerminal() const;
-    bool IsLeaf() const;
+        std::strong_ordering operator<=>(const Node& other) const;
 
-    void Traverse(Callback callback, std::size_t code = 0, std::size_t height = 0) const;
-    void AddCode(std::size_t code, std::size_t size, Char key, std::size_t count = 1, std::size_t height = 0);
+        bool IsTerminal() const;
+        bool IsLeaf() const;
+    };
 
-    BinaryTrie& Left();
-    BinaryTrie& Right();
+    BinaryTrie();
 
-    const BinaryTrie& CLeft() const;
-    const BinaryTrie& CRight() const;
+    void Clear();
+    void Reserve(std::size_t size);
 
-    std::size_t count_ = 0;
-    Char key_ = std::numeric_limits<Char>::max();
+    Index AddLeaf(Char key, std::size_t count);
+    Index AddNode(Index left, Index right);
 
-private:
-    bool terminal_ = false;
+    const Node& operator[](Index index) const;
+    Index Root() const;
+    Index Child(Index index, bool bit) const;
 
-    Pointer left_ = nullptr;
-    Pointer right_ = nullptr;
+    void Traverse(Callback callback) const;
+    void Traverse(Index root, Callback callback) const;
+    void AddCode(std::size_t code, std::size_t size, Char key, std::size_t count = 1);
 
-    void Relax();
-};
+private:
+    std::vector<Node> nodes_;
 
-bool PointerCompare(const BinaryTrie::Pointer& lhs, const BinaryTrie::Pointer& rhs);
+    Index Allocate();
+};
 
 #endif  // ARCHIVER_BINARY_TRIE_
@@ -1,70 +1,139 @@
 #ifndef ARCHIVER_BIT_STREAM_
 #define ARCHIVER_BIT_STREAM_
 
+#include <climits>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <ios>
 #include <iostream>
+#include <memory>
+#include <span>
 
-class BitReader {
-    const static std::streamsize BUFFER_CAPACITY = 1 << 12;
+#include "input_source.h"
+#include "output_sink.h"
 
+class BitReader {
 public:
+    const static std::size_t WORD_BITS = sizeof(std::uint64_t) * CHAR_BIT;
+    const static std::size_t MAX_PEEK_BITS = WORD_BITS - CHAR_BIT + 1;
+
     class EndOfFile : public std::exception {};
 
     explicit BitReader(std::istream& is);
+    explicit BitReader(InputSource& source);
 
     bool ReadBit();
 
     template <typename T>
     T ReadBits(std::size_t count) {
-        T bits = 0;
-        for (std::size_t i = 0; i < count; ++i) {
-            std::size_t bit_position = count - i - 1;
-            bits |= static_cast<T>(ReadBit()) << bit_position;
+        std::uint64_t bits = 0;
+        while (count > MAX_PEEK_BITS) {
+            bits = (bits << MAX_PEEK_BITS) | PeekBits(MAX_PEEK_BITS);
+            ConsumeBits(MAX_PEEK_BITS);
+            count -= MAX_PEEK_BITS;
         }
-        return bits;
+        bits = (bits << count) | PeekBits(count);
+        ConsumeBits(count);
+        return static_cast<T>(bits);
     }
 
-    bool Eof() const;
+    std::uint64_t PeekBits(std::size_t count) {
+        if (bits_count_ < count) {
+            Refill();
+        }
+        if (count == 0) {
+            return 0;
+        }
+        return bit_buffer_ >> (WORD_BITS - count);
+    }
+
+    void ConsumeBits(std::size_t count) {
+        if (bits_count_ < count) {
+            Refill();
+            if (bits_count_ < count) {
+                throw EndOfFile();
+            }
+        }
+        bit_buffer_ = count == WORD_BITS ? 0 : bit_buffer_ << count;
+        bits_count_ -= count;
+    }
+
+    void AlignToByte();
+    void ReadBytes(std::span<std::uint8_t> data);
+
+    bool Eof();
+
+    std::uint64_t Position() const;
 
 private:
-    char buffer_[BUFFER_CAPACITY + 1];
-    std::streamsize buffer_pos_ = 0;
-    std::streamsize buffer_size_ = 0;
-    int current_bit_ = 0;
+    std::unique_ptr<InputSource> owned_source_;
+    InputSource& source_;
+
+    std::span<const std::uint8_t> chunk_;
+    std::size_t chunk_pos_ = 0;
+    std::uint64_t chunk_offset_ = 0;
+    bool exhausted_ = false;
 
-    std::istream& is_;
+    std::uint64_t bit_buffer_ = 0;
+    std::size_t bits_count_ = 0;
 
     void BufferFill();
+    void Refill();
 };
 
 class BitWriter {
     const static std::streamsize BUFFER_SIZE = 1 << 12;
 
 public:
-    explicit BitWriter(std::ostream& is);
+    const static std::size_t WORD_BITS = sizeof(std::uint64_t) * CHAR_BIT;
+    const static std::size_t MAX_WRITE_BITS = WORD_BITS - CHAR_BIT + 1;
+
+    explicit BitWriter(std::ostream& os);
+    // Position counts from position bytes, for writers that continue an existing file.
+    explicit BitWriter(OutputSink& sink, std::uint64_t position = 0);
     ~BitWriter();
 
     void WriteBit(bool val);
+    void WriteBytes(std::span<const std::uint8_t> data);
+    void Flush();
+
+    std::uint64_t Position() const;
 
     template <typename T>
     void WriteBits(T data, std::size_t count) {
-        for (std::size_t i = 0; i < count; ++i) {
-            std::size_t bit_position = count - i - 1;
-            WriteBit((data >> bit_position) & 1);
+        while (count > MAX_WRITE_BITS) {
+            count -= MAX_WRITE_BITS;
+            WriteWord(static_cast<std::uint64_t>(data) >> count, MAX_WRITE_BITS);
         }
+        WriteWord(static_cast<std::uint64_t>(data), count);
+    }
+
+    void WriteWord(std::uint64_t data, std::size_t count) {
+        if (bits_count_ + count > WORD_BITS) {
+            FlushBytes();
+        }
+        if (count == 0) {
+            return;
+        }
+        data &= ~std::uint64_t{0} >> (WORD_BITS - count);
+        bit_buffer_ |= data << (WORD_BITS - bits_count_ - count);
+        bits_count_ += count;
     }
 
 private:
-    char buffer_[BUFFER_SIZE] = {0};
+    std::uint8_t buffer_[BUFFER_SIZE + sizeof(std::uint64_t)] = {0};
     std::streamsize buffer_pos_ = 0;
-    int current_bit_ = 0;
+    std::uint64_t flushed_ = 0;
+
+    std::uint64_t bit_buffer_ = 0;
+    std::size_t bits_count_ = 0;
 
-    std::ostream& os_;
+    std::unique_ptr<OutputSink> owned_sink_;
+    OutputSink& sink_;
 
+    void FlushBytes();
     void BufferFlush();
 };
 
-#endif  // ARCHIVER_BIT_STREAM_
\ No newline at end of file
+#endif  // ARCHIVER_BIT_STREAM_
@@ -0,0 +1,101 @@
+#ifndef ARCHIVER_BLOCK_CODEC_
+#define ARCHIVER_BLOCK_CODEC_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "archive_format.h"
+#include "dictionary.h"
+#include "huffman.h"
+#include "lz77.h"
+
+class DecodeTable;
+
+struct EncodedBlock {
+    std::size_t raw_size = 0;
+    std::vector<std::uint8_t> payload;
+    bool shared_table = false;
+    std::uint32_t checksum = 0;
+};
+
+class BlockCodec {
+public:
+    virtual ~BlockCodec() = default;
+
+    virtual EncodedBlock Encode(std::span<const std::uint8_t> data) const = 0;
+    virtual void Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const = 0;
+
+    // Sizes of the parts the data is better encoded as, each with its own table.
+    virtual std::vector<std::size_t> Split(std::span<const std::uint8_t> data) const;
+
+    // Encodes consecutive parts; a part may reuse the table of the first non-empty one and is then marked shared.
+    virtual std::vector<EncodedBlock> EncodeGroup(const std::vector<std::span<const std::uint8_t>>& parts) const;
+    // The table is read once from the payload of the block that owns it and reused for every block sharing it.
+    virtual std::shared_ptr<const DecodeTable> ReadSharedTable(std::span<const std::uint8_t> table_payload) const;
+    virtual void DecodeShared(const DecodeTable& table, std::span<const std::uint8_t> payload,
+                              std::span<std::uint8_t> output) const;
+};
+
+// With a dictionary every block starts with a bit choosing between the dictionary table and its own table.
+class HuffmanCodec : public BlockCodec {
+public:
+    explicit HuffmanCodec(std::size_t max_code_size = 0, bool adaptive = false,
+                          std::shared_ptr<const Dictionary> dictionary = nullptr);
+
+    EncodedBlock Encode(std::span<const std::uint8_t> data) const override;
+    void Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const override;
+    std::vector<std::size_t> Split(std::span<const std::uint8_t> data) const override;
+    std::vector<EncodedBlock> EncodeGroup(const std::vector<std::span<const std::uint8_t>>& parts) const override;
+    std::shared_ptr<const DecodeTable> ReadSharedTable(std::span<const std::uint8_t> table_payload) const override;
+    void DecodeShared(const DecodeTable& table, std::span<const std::uint8_t> payload,
+                      std::span<std::uint8_t> output) const override;
+
+private:
+    std::size_t max_code_size_;
+    bool adaptive_;
+    std::shared_ptr<const Dictionary> dictionary_;
+    CodeTable dictionary_codes_{};
+    std::shared_ptr<const DecodeTable> dictionary_table_;
+};
+
+class RansCodec : public BlockCodec {
+public:
+    EncodedBlock Encode(std::span<const std::uint8_t> data) const override;
+    void Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const override;
+};
+
+class Lz77Codec : public BlockCodec {
+public:
+    explicit Lz77Codec(const Lz77Options& options = {}, std::size_t max_code_size = 0);
+
+    EncodedBlock Encode(std::span<const std::uint8_t> data) const override;
+    void Decode(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) const override;
+
+private:
+    Lz77Options options_;
+    std::size_t max_code_size_;
+};
+
+std::shared_ptr<const BlockCodec> CreateCodec(CodecId codec);
+std::shared_ptr<const BlockCodec> CreateCodec(const CompressOptions& options,
+                                              std::shared_ptr<const Dictionary> dictionary = nullptr);
+
+EncodedBlock EncodeBlock(std::span<const std::uint8_t> data, std::size_t max_code_size = 0);
+void DecodeBlock(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output);
+std::vector<EncodedBlock> EncodeBlockGroup(const std::vector<std::span<const std::uint8_t>>& parts,
+                                           std::size_t max_code_size = 0);
+DecodeTable ReadSharedBlockTable(std::span<const std::uint8_t> table_payload);
+void DecodeSharedBlock(const DecodeTable& table, std::span<const std::uint8_t> payload, std::span<std::uint8_t> output);
+std::vector<std::size_t> SplitBlock(std::span<const std::uint8_t> data, std::size_t max_code_size = 0);
+
+EncodedBlock EncodeRansBlock(std::span<const std::uint8_t> data);
+void DecodeRansBlock(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output);
+
+EncodedBlock EncodeLz77Block(std::span<const std::uint8_t> data, const Lz77Options& options = {},
+                             std::size_t max_code_size = 0);
+void DecodeLz77Block(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output);
+
+#endif  // ARCHIVER_BLOCK_CODEC_
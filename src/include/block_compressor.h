@@ -0,0 +1,97 @@
+#ifndef ARCHIVER_BLOCK_COMPRESSOR_
+#define ARCHIVER_BLOCK_COMPRESSOR_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "archive_format.h"
+#include "bit_stream.h"
+#include "block_codec.h"
+#include "dedup.h"
+#include "dictionary.h"
+#include "files.h"
+#include "output_sink.h"
+#include "thread_pool.h"
+
+class BlockCompressor {
+public:
+    // With an append point new members go to the end of that existing archive.
+    BlockCompressor(Path archive_name, const CompressOptions& options,
+                    std::optional<AppendPoint> append_point = std::nullopt);
+
+    void CompressFile(const InputFile& input, bool is_last = false);
+    // Writes the end marker and the directory.
+    void Finish();
+
+private:
+    // A chunk without blocks repeats an earlier chunk with the same key. Chunks without a key, such as the members of
+    // a solid group whose blocks share a table, are not deduplicated. The checksum of a chunk with a key is taken from
+    // its own data, so a member that repeats a wrong chunk fails verification.
+    struct EncodedChunk {
+        std::optional<ChunkKey> key;
+        std::uint32_t checksum = 0;
+        std::vector<EncodedBlock> blocks;
+    };
+
+    // Chunks of the members of a pool task and the stage times the task collected.
+    struct EncodedMembers {
+        std::vector<std::vector<EncodedChunk>> chunks;
+        Stats stats;
+    };
+
+    // Chunks of the last started member, or the chunks of every member when members is not empty.
+    struct PendingBlocks {
+        std::vector<MemberEntry> members;
+        std::future<EncodedMembers> encoded;
+    };
+
+    std::ofstream os_;
+    AsyncSink sink_;
+    BitWriter output_;
+
+    std::size_t block_size_;
+    std::size_t io_chunk_size_;
+    bool solid_;
+    Stats* stats_;
+    std::size_t max_chunk_size_;
+    std::shared_ptr<ChunkIndex> chunk_index_;
+    std::shared_ptr<const Dictionary> dictionary_;
+    std::shared_ptr<const BlockCodec> codec_;
+    std::size_t max_pending_;
+
+    ThreadPool pool_;
+    std::deque<PendingBlocks> pending_;
+
+    std::vector<MemberEntry> group_;
+    std::vector<Path> group_files_;
+    std::size_t group_size_ = 0;
+
+    ArchiveDirectory directory_;
+
+    // Encodes the data cut into pieces of the given sizes. With an index the pieces are chunks, and chunks that the
+    // index already has are not encoded.
+    static std::vector<EncodedChunk> EncodeChunks(const BlockCodec& codec, std::span<const std::uint8_t> data,
+                                                  const std::vector<std::size_t>& sizes, const ChunkIndex* index);
+
+    std::vector<std::uint8_t> SubmitBlock(std::vector<std::uint8_t> block, bool is_last);
+    void SubmitFile(const std::string& name, Path filename);
+    void AddToGroup(const std::string& name, Path filename, std::size_t size);
+    void SubmitGroup();
+    void WritePending(std::size_t max_pending);
+    void WriteMemberStart(MemberEntry member);
+    void WriteMemberEnd();
+    void WriteChunks(const std::vector<EncodedChunk>& chunks);
+    void WriteBlock(const EncodedBlock& block);
+    // Leaves the member checksum to the caller, which takes it from the repeated data rather than from the target.
+    void WriteReference(const BlockEntry& target);
+};
+
+#endif  // ARCHIVER_BLOCK_COMPRESSOR_
@@ -0,0 +1,97 @@
+#ifndef ARCHIVER_BLOCK_DECOMPRESSOR_
+#define ARCHIVER_BLOCK_DECOMPRESSOR_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "archive_format.h"
+#include "bit_stream.h"
+#include "block_codec.h"
+#include "decode_table.h"
+#include "files.h"
+#include "input_source.h"
+#include "output_sink.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+class BlockDecompressor {
+public:
+    explicit BlockDecompressor(Path archive_name, OutputMode output_mode = OutputMode::Files, Path dictionary = {},
+                               std::size_t io_chunk_size = 0, Stats* stats = nullptr);
+
+    bool DecompressFile();
+
+private:
+    std::unique_ptr<InputSource> source_;
+    BitReader input_;
+    RandomAccessFile archive_;
+    std::uint64_t archive_end_;
+    std::ofstream file_;
+    std::ostream* os_ = nullptr;
+    std::unique_ptr<AsyncSink> sink_;
+    OutputMode output_mode_;
+    std::size_t io_chunk_size_;
+    Stats* stats_;
+    std::shared_ptr<const BlockCodec> codec_;
+    std::vector<std::uint8_t> table_payload_;
+    // Built from table_payload_ when the first block sharing it arrives.
+    std::shared_ptr<const DecodeTable> shared_table_;
+
+    ArchiveDirectory members_;
+
+    void OpenFile(Path filename);
+    // Checks a directory and its trailer against the members decoded so far.
+    void VerifyDirectory();
+
+    std::size_t ReadSize(std::size_t bits);
+    std::string ReadName(std::size_t size);
+};
+
+class IndexedDecompressor {
+public:
+    IndexedDecompressor(Path archive_name, std::size_t threads_count, Path dictionary = {}, Stats* stats = nullptr);
+
+    void DecompressAll();
+    void TestAll();
+    void DecompressFiles(const std::vector<std::string>& names);
+    void List(std::ostream& os) const;
+
+private:
+    struct PendingBlock {
+        const MemberEntry* member;
+        std::size_t raw_size;
+        std::future<std::uint32_t> checksum;
+    };
+
+    std::shared_ptr<RandomAccessFile> archive_;
+    std::shared_ptr<const BlockCodec> codec_;
+    ArchiveDirectory directory_;
+    // The last member with each name, a member added again replaces the earlier ones on extraction.
+    std::unordered_map<std::string_view, const MemberEntry*> members_;
+    Stats* stats_;
+    std::unordered_map<const BlockEntry*, const BlockEntry*> tables_;
+    const BlockEntry* shared_table_owner_ = nullptr;
+    std::shared_ptr<const DecodeTable> shared_table_;
+
+    std::size_t max_pending_;
+    ThreadPool pool_;
+    std::deque<PendingBlock> pending_;
+
+    std::uint32_t checksum_ = 0;
+    std::uint64_t verified_size_ = 0;
+
+    void DecompressFile(const MemberEntry& member, OutputMode output_mode = OutputMode::Files);
+    void WaitPending(std::size_t max_pending);
+    void VerifyMember(const MemberEntry& member);
+};
+
+#endif  // ARCHIVER_BLOCK_DECOMPRESSOR_
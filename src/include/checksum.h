@@ -0,0 +1,15 @@
+#ifndef ARCHIVER_CHECKSUM_
+#define ARCHIVER_CHECKSUM_
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+using Sha256Digest = std::array<std::uint8_t, 32>;
+
+std::uint32_t Crc32c(std::span<const std::uint8_t> data, std::uint32_t crc = 0);
+std::uint32_t Crc32cCombine(std::uint32_t first, std::uint32_t second, std::uint64_t second_size);
+// Unlike CRC32C, finding two inputs with the same digest is infeasible, so equal digests stand for equal data.
+Sha256Digest Sha256(std::span<const std::uint8_t> data);
+
+#endif  // ARCHIVER_CHECKSUM_
@@ -5,46 +5,54 @@
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "archive_format.h"
 #include "bit_stream.h"
 #include "constants.h"
 #include "files.h"
 #include "huffman.h"
+#include "input_source.h"
+#include "output_sink.h"
+#include "stats.h"
 
 class Compressor {
 public:
-    explicit Compressor(Path archive_name);
+    explicit Compressor(Path archive_name, std::size_t max_code_size = 0, std::size_t io_chunk_size = 0,
+                        Stats* stats = nullptr);
 
-    void CompressFile(Path filename, bool is_last = false);
+    void CompressFile(const InputFile& input, bool is_last = false);
 
 private:
-    std::ifstream input_;
+    std::unique_ptr<InputSource> input_;
     std::ofstream os_;
+    AsyncSink sink_;
     BitWriter output_;
 
     std::string current_file_;
+    std::size_t max_code_size_;
+    std::size_t io_chunk_size_;
+    Stats* stats_;
 
-    SymbolsCount symbols_count_;
-    std::unordered_map<std::size_t, std::size_t> sizes_count_;
-    CodeTable codes_;
+    SymbolsCount symbols_count_{};
+    CodeSizes sizes_;
+    CodeTable codes_{};
 
-    std::size_t max_size_;
-    Alphabet alphabet_;
-
-    void OpenFile(Path filename);
+    void OpenFile(const InputFile& input);
     void ResetPosition();
 
     void CountSymbols();
     void Reset();
 
     void WriteSymbol(Char symbol);
-    void WriteNumber(std::size_t number);
     void WriteFile(bool is_last = true);
 };
 
-void Compress(Path archive_name, const std::vector<Path>& filenames);
+void Compress(Path archive_name, const std::vector<Path>& filenames, const CompressOptions& options = {});
+// Adds files to a block archive in place, they are coded with the codec of the archive. A missing archive is created.
+void Append(Path archive_name, const std::vector<Path>& filenames, CompressOptions options = {});
 
 #endif  // ARCHIVER_COMPRESSOR_
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ARCHIVER_CONSTANTS_
 #define ARCHIVER_CONSTANTS_
 
+#include <cstddef>
 #include <cstdint>
 
 using Char = std::int16_t;
@@ -8,5 +9,9 @@ using Char = std::int16_t;
 const Char FILENAME_END = 256;
 const Char ONE_MORE_FILE = 257;
 const Char END_OF_ARCHIVE = 258;
+const Char FIRST_MATCH_CODE = END_OF_ARCHIVE + 1;
+
+const std::size_t MATCH_CODES_COUNT = 16;
+const std::size_t ALPHABET_SIZE = FIRST_MATCH_CODE + MATCH_CODES_COUNT;
 
 #endif  // ARCHIVER_CONSTANTS_
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef ARCHIVER_DECODE_TABLE_
+#define ARCHIVER_DECODE_TABLE_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "bit_stream.h"
+#include "constants.h"
+#include "huffman.h"
+
+class DecodeTable {
+public:
+    const static std::size_t PRIMARY_BITS = 10;
+    const static std::size_t SECONDARY_BITS = 6;
+
+    class InvalidCode : public std::exception {};
+
+    explicit DecodeTable(const CodeTable& codes, std::size_t primary_bits = PRIMARY_BITS);
+
+    Char Decode(BitReader& input) const;
+
+    std::size_t Size() const;
+
+private:
+    struct Entry {
+        Char key = 0;
+        std::uint8_t size = 0;
+        std::uint8_t table_bits = 0;
+        std::uint32_t table_offset = 0;
+    };
+
+    std::vector<Entry> entries_;
+    std::size_t primary_bits_ = 0;
+
+    using KeyedCodes = std::vector<std::pair<Char, Code>>;
+
+    void Build(const KeyedCodes& codes, std::size_t begin, std::size_t end, std::size_t offset, std::size_t bits,
+               std::size_t consumed);
+    std::size_t AllocateTable(std::size_t bits);
+};
+
+#endif  // ARCHIVER_DECODE_TABLE_
@@ -1,42 +1,77 @@
 #ifndef ARCHIVER_DECOMPRESSOR_
 #define ARCHIVER_DECOMPRESSOR_
 
+#include <cstddef>
 #include <fstream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
 
 #include "binary_trie.h"
 #include "bit_stream.h"
 #include "constants.h"
+#include "decode_table.h"
 #include "files.h"
 #include "huffman.h"
+#include "input_source.h"
+#include "stats.h"
+
+enum class DecoderType { Table, Trie };
+
+struct DecompressOptions {
+    DecoderType decoder = DecoderType::Table;
+    std::size_t threads_count = 1;
+    bool standard_output = false;
+    Path dictionary;
+    std::size_t io_chunk_size = 0;
+    Stats* stats = nullptr;
+};
 
 class Decompressor {
 public:
-    explicit Decompressor(Path archive_name);
+    explicit Decompressor(Path archive_name, DecoderType decoder = DecoderType::Table,
+                          OutputMode output_mode = OutputMode::Files, std::size_t io_chunk_size = 0,
+                          Stats* stats = nullptr);
 
     bool DecompressFile();
 
 private:
-    std::ifstream is_;
+    std::unique_ptr<InputSource> source_;
     BitReader input_;
-    std::ofstream os_;
+    std::ofstream file_;
+    // Stays nullptr when decoded files are discarded.
+    std::ostream* os_ = nullptr;
+    DecoderType decoder_;
+    OutputMode output_mode_;
+    Stats* stats_;
+    std::vector<char> buffer_;
 
-    CodeTable codes_;
-    BinaryTrie::Pointer trie_;
+    CodeTable codes_{};
+    BinaryTrie trie_;
+    std::optional<DecodeTable> table_;
 
     void OpenFile(Path filename);
     void Reset();
 
-    Char ReadNumber();
     Char ReadSymbol();
-    Char ReadSymbol(const BinaryTrie& node);
+    Char ReadTrieSymbol();
     void ReadHeader();
     std::string ReadFilename();
 
     void GenerateTrie();
+    void GenerateTable();
 
-    void WriteFile();
+    // Decodes symbols into the buffer until it is full or the file ends, returns the symbol that ends the file.
+    std::optional<Char> DecodeBuffer();
+    void WriteBuffer();
 };
 
-void Decompress(Path archive_name);
+void Decompress(Path archive_name, const DecompressOptions& options = {});
+// Decodes every file and checks the checksums of block archives without writing anything.
+void Test(Path archive_name, const DecompressOptions& options = {});
+void Extract(Path archive_name, const std::vector<std::string>& names, const DecompressOptions& options = {});
+void List(Path archive_name, std::ostream& os);
 
 #endif  // ARCHIVER_DECOMPRESSOR_
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef ARCHIVER_DEDUP_
+#define ARCHIVER_DEDUP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "archive_format.h"
+#include "checksum.h"
+
+const std::size_t MIN_CHUNK_SIZE = 1 << 13;
+const std::size_t MAX_CHUNK_SIZE = 1 << 17;
+// Chunks end on average 2^CHUNK_BITS bytes after the minimum size.
+const std::size_t CHUNK_BITS = 15;
+
+// Chunk boundaries depend only on the bytes just before them, so an insertion moves the boundaries near it only.
+std::size_t FindChunkEnd(std::span<const std::uint8_t> data, std::size_t max_size = MAX_CHUNK_SIZE);
+std::vector<std::size_t> FindChunks(std::span<const std::uint8_t> data, std::size_t max_size = MAX_CHUNK_SIZE);
+
+// Chunks are matched by digest alone and never compared byte by byte, so the digest has to be collision resistant.
+struct ChunkKey {
+    Sha256Digest digest{};
+    std::uint32_t size = 0;
+
+    bool operator==(const ChunkKey& other) const = default;
+};
+
+struct ChunkKeyHash {
+    std::size_t operator()(const ChunkKey& key) const {
+        std::size_t hash = 0;
+        std::memcpy(&hash, key.digest.data(), sizeof(hash));
+        return hash;
+    }
+};
+
+ChunkKey MakeChunkKey(std::span<const std::uint8_t> data);
+
+// Blocks written for each chunk. Only the archive writer inserts, encoders look up chunks to skip from other threads.
+class ChunkIndex {
+public:
+    bool Contains(const ChunkKey& key) const;
+    const std::vector<BlockEntry>* Find(const ChunkKey& key) const;
+    void Insert(const ChunkKey& key, std::vector<BlockEntry> blocks);
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<ChunkKey, std::vector<BlockEntry>, ChunkKeyHash> blocks_;
+};
+
+#endif  // ARCHIVER_DEDUP_
@@ -0,0 +1,24 @@
+#ifndef ARCHIVER_DICTIONARY_
+#define ARCHIVER_DICTIONARY_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "files.h"
+#include "huffman.h"
+
+const std::array<std::uint8_t, 4> DICTIONARY_MAGIC = {'A', 'D', 'I', 'C'};
+const std::uint8_t DICTIONARY_VERSION = 1;
+
+// A static code table with a code for every byte value, identified by the checksum of its encoding.
+struct Dictionary {
+    std::uint32_t id = 0;
+    CodeSizes sizes;
+};
+
+Dictionary TrainDictionary(const std::vector<Path>& samples);
+void SaveDictionary(Path filename, const Dictionary& dictionary);
+Dictionary LoadDictionary(Path filename);
+
+#endif  // ARCHIVER_DICTIONARY_
@@ -36,6 +36,54 @@ public:
     }
 };
 
+class MissingDirectory : public ArchiverException {
+public:
+    MissingDirectory() : ArchiverException("Archive has no member directory") {
+    }
+};
+
+class MemberNotFound : public ArchiverException {
+public:
+    MemberNotFound() : ArchiverException("Archive has no such file") {
+    }
+};
+
+class ChecksumMismatch : public ArchiverException {
+public:
+    ChecksumMismatch() : ArchiverException("Checksum mismatch, archive is corrupted") {
+    }
+};
+
+class MissingDictionary : public ArchiverException {
+public:
+    MissingDictionary() : ArchiverException("Archive was compressed with a dictionary, specify it with --dict") {
+    }
+};
+
+class DictionaryMismatch : public ArchiverException {
+public:
+    DictionaryMismatch() : ArchiverException("Dictionary does not match the archive") {
+    }
+};
+
+class InvalidDictionary : public ArchiverException {
+public:
+    InvalidDictionary() : ArchiverException("Invalid dictionary format") {
+    }
+};
+
+class UnsafePath : public ArchiverException {
+public:
+    UnsafePath() : ArchiverException("Archived file path leads outside of the output directory") {
+    }
+};
+
+class InputError : public ArchiverException {
+public:
+    InputError() : ArchiverException("Cannot read one of input files") {
+    }
+};
+
 class OutputError : public ArchiverException {
 public:
     OutputError() : ArchiverException("Cannot write one of archived files") {
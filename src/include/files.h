@@ -1,11 +1,57 @@
 #ifndef ARCHIVER_FILES_
 #define ARCHIVER_FILES_
 
+#include <cstdint>
 #include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
 
 using Path = std::filesystem::path;
 
+const Path STANDARD_STREAM = "-";
+
+// Where decoded files go, Discard only checks that they decode.
+enum class OutputMode { Files, StandardOutput, Discard };
+
 bool ValidateOutput(Path archive_name);
 bool ValidateInput(Path filename);
+bool IsSeekable(Path filename);
+
+// A file to archive and the name it is stored under.
+struct InputFile {
+    Path path;
+    std::string name;
+};
+
+// Files are named by their file name and directories are replaced by the regular files inside them, sorted and named
+// by their path relative to the parent of the directory. Files inside the directories that are the archive being
+// written are skipped.
+std::vector<InputFile> CollectInputs(const std::vector<Path>& paths, Path archive_name = {});
+// Rejects archived names that are absolute or go up a directory, creates the parent directories of the rest.
+Path PrepareOutput(const std::string& name);
+
+class RandomAccessFile {
+public:
+    static RandomAccessFile Open(Path filename);
+    static RandomAccessFile Create(Path filename, std::uint64_t size);
+
+    RandomAccessFile(RandomAccessFile&& other) noexcept;
+    RandomAccessFile& operator=(RandomAccessFile&& other) noexcept;
+    ~RandomAccessFile();
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    void ReadAt(std::span<std::uint8_t> data, std::uint64_t offset) const;
+    void WriteAt(std::span<const std::uint8_t> data, std::uint64_t offset) const;
+
+    std::uint64_t Size() const;
+
+private:
+    int fd_ = -1;
+
+    explicit RandomAccessFile(int fd);
+};
 
-#endif  // ARCHIVER_FILES_
\ No newline at end of file
+#endif  // ARCHIVER_FILES_
@@ -1,17 +1,22 @@
 #ifndef ARCHIVER_HUFFMAN_
 #define ARCHIVER_HUFFMAN_
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
-#include <unordered_map>
+#include <span>
 #include <vector>
 
 #include "binary_trie.h"
+#include "bit_stream.h"
 #include "constants.h"
 
+const std::size_t MAX_CODE_SIZE = 56;
+const std::size_t CODE_SIZE_BITS = 8;
+
 struct Code {
-    std::size_t code;
-    std::size_t size;
+    std::uint64_t code : MAX_CODE_SIZE = 0;
+    std::uint64_t size : CODE_SIZE_BITS = 0;
 };
 
 struct CodeSize {
@@ -22,13 +27,29 @@ struct CodeSize {
 };
 
 using Alphabet = std::vector<Char>;
-using SymbolsCount = std::unordered_map<Char, std::size_t>;
+using SymbolsCount = std::array<std::size_t, ALPHABET_SIZE>;
 using CodeSizes = std::vector<CodeSize>;
-using CodeTable = std::unordered_map<Char, Code>;
+using CodeTable = std::array<Code, ALPHABET_SIZE>;
 
-bool PointerCompare(const BinaryTrie::Pointer& lhs, const BinaryTrie::Pointer& rhs);
+const std::size_t DEFAULT_MAX_CODE_SIZE = 15;
+const std::size_t CODE_LENGTH_BITS = 6;
+
+void CountBytes(std::span<const std::uint8_t> data, SymbolsCount& symbols_count);
 
 CodeSizes HuffmanEncoding(const SymbolsCount& symbols_count);
+CodeSizes TreeHuffmanEncoding(const SymbolsCount& symbols_count);
+CodeSizes LimitedHuffmanEncoding(const SymbolsCount& symbols_count, std::size_t max_size = DEFAULT_MAX_CODE_SIZE);
 CodeTable CanonicalCodes(const CodeSizes& sizes);
 
+std::size_t EncodedBits(const SymbolsCount& symbols_count, std::size_t max_size = DEFAULT_MAX_CODE_SIZE);
+
+void EncodeBuffer(BitWriter& output, const CodeTable& codes, std::span<const std::uint8_t> data);
+
+void WriteCodeSizes(BitWriter& output, const CodeSizes& sizes);
+CodeSizes ReadCodeSizes(BitReader& input);
+
+// Code lengths in key order, with runs of repeated lengths and steps of one coded in a few bits.
+void WriteCompactCodeSizes(BitWriter& output, const CodeSizes& sizes);
+CodeSizes ReadCompactCodeSizes(BitReader& input);
+
 #endif  // ARCHIVER_HUFFMAN_
@@ -0,0 +1,119 @@
+#ifndef ARCHIVER_INPUT_SOURCE_
+#define ARCHIVER_INPUT_SOURCE_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "files.h"
+
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+
+    virtual std::span<const std::uint8_t> Next() = 0;
+    virtual void Rewind() = 0;
+};
+
+class MemorySource : public InputSource {
+public:
+    explicit MemorySource(std::span<const std::uint8_t> data);
+
+    std::span<const std::uint8_t> Next() override;
+    void Rewind() override;
+
+private:
+    std::span<const std::uint8_t> data_;
+    bool consumed_ = false;
+};
+
+class StreamSource : public InputSource {
+public:
+    const static std::size_t CHUNK_SIZE = 1 << 16;
+
+    explicit StreamSource(std::istream& is, std::size_t chunk_size = CHUNK_SIZE);
+    explicit StreamSource(Path filename, std::size_t chunk_size = CHUNK_SIZE);
+
+    std::span<const std::uint8_t> Next() override;
+    void Rewind() override;
+
+private:
+    std::unique_ptr<std::ifstream> file_;
+    std::istream& is_;
+    std::vector<std::uint8_t> buffer_;
+};
+
+class MappedSource : public InputSource {
+public:
+    const static std::size_t WINDOW_SIZE = 1 << 26;
+
+    explicit MappedSource(Path filename);
+    ~MappedSource() override;
+
+    MappedSource(const MappedSource&) = delete;
+    MappedSource& operator=(const MappedSource&) = delete;
+
+    std::span<const std::uint8_t> Next() override;
+    void Rewind() override;
+
+private:
+    int fd_ = -1;
+    std::size_t size_ = 0;
+    std::size_t offset_ = 0;
+
+    void* window_ = nullptr;
+    std::size_t window_size_ = 0;
+
+    void Unmap();
+};
+
+// Reads the wrapped source ahead on its own thread into a ring of chunks; a zero chunk size means CHUNK_SIZE.
+class PrefetchSource : public InputSource {
+public:
+    const static std::size_t CHUNK_SIZE = 1 << 20;
+    const static std::size_t CHUNKS_COUNT = 4;
+
+    explicit PrefetchSource(std::unique_ptr<InputSource> source, std::size_t chunk_size = CHUNK_SIZE,
+                            std::size_t chunks_count = CHUNKS_COUNT);
+    ~PrefetchSource() override;
+
+    PrefetchSource(const PrefetchSource&) = delete;
+    PrefetchSource& operator=(const PrefetchSource&) = delete;
+
+    std::span<const std::uint8_t> Next() override;
+    void Rewind() override;
+
+private:
+    std::unique_ptr<InputSource> source_;
+    std::size_t chunk_size_;
+    std::vector<std::vector<std::uint8_t>> chunks_;
+
+    std::size_t filled_ = 0;
+    std::size_t consumed_ = 0;
+    bool holding_ = false;
+    bool finished_ = false;
+    bool stopped_ = false;
+    std::exception_ptr error_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread reader_;
+
+    void Start();
+    void Stop();
+    void Read();
+};
+
+std::unique_ptr<InputSource> OpenSource(Path filename);
+// Files that fit in one chunk are opened without a reader thread.
+std::unique_ptr<InputSource> OpenPrefetchSource(Path filename, std::size_t chunk_size = 0);
+
+#endif  // ARCHIVER_INPUT_SOURCE_
@@ -0,0 +1,47 @@
+#ifndef ARCHIVER_LZ77_
+#define ARCHIVER_LZ77_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+const std::size_t MIN_MATCH_SIZE = 3;
+const std::size_t MAX_MATCH_SIZE = 258;
+
+const std::size_t MIN_WINDOW_BITS = 10;
+const std::size_t MAX_WINDOW_BITS = 24;
+const std::size_t DEFAULT_WINDOW_BITS = 18;
+
+const std::size_t MIN_LEVEL = 1;
+const std::size_t MAX_LEVEL = 9;
+const std::size_t DEFAULT_LEVEL = 6;
+
+const std::size_t DISTANCE_CODES_COUNT = 2 * MAX_WINDOW_BITS;
+
+struct Lz77Options {
+    std::size_t level = DEFAULT_LEVEL;
+    std::size_t window_bits = DEFAULT_WINDOW_BITS;
+};
+
+// A literal when size is zero, otherwise a copy of size bytes starting distance bytes back.
+struct Lz77Token {
+    std::uint32_t distance = 0;
+    std::uint16_t size = 0;
+    std::uint8_t literal = 0;
+};
+
+// Values are coded as a small code followed by extra bits, with two codes per power of two.
+struct ValueCode {
+    std::size_t code = 0;
+    std::size_t extra_bits = 0;
+    std::size_t extra = 0;
+};
+
+ValueCode EncodeValue(std::size_t value);
+std::size_t ValueBase(std::size_t code);
+std::size_t ValueExtraBits(std::size_t code);
+
+std::vector<Lz77Token> FindMatches(std::span<const std::uint8_t> data, const Lz77Options& options = {});
+
+#endif  // ARCHIVER_LZ77_
@@ -0,0 +1,79 @@
+#ifndef ARCHIVER_OUTPUT_SINK_
+#define ARCHIVER_OUTPUT_SINK_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <thread>
+#include <vector>
+
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    virtual void Write(std::span<const std::uint8_t> data) = 0;
+};
+
+// Throws OutputError once the stream fails, data still buffered in the stream is only checked by its owner's flush.
+class StreamSink : public OutputSink {
+public:
+    explicit StreamSink(std::ostream& os);
+
+    void Write(std::span<const std::uint8_t> data) override;
+
+private:
+    std::ostream& os_;
+};
+
+class MemorySink : public OutputSink {
+public:
+    explicit MemorySink(std::vector<std::uint8_t>& data);
+
+    void Write(std::span<const std::uint8_t> data) override;
+
+private:
+    std::vector<std::uint8_t>& data_;
+};
+
+// Collects writes into large chunks and passes full ones to the wrapped sink on its own thread. The thread is only
+// started once a chunk fills up, so short outputs are written directly by Close. A zero chunk size means CHUNK_SIZE.
+class AsyncSink : public OutputSink {
+public:
+    const static std::size_t CHUNK_SIZE = 1 << 20;
+    const static std::size_t CHUNKS_COUNT = 4;
+
+    explicit AsyncSink(std::unique_ptr<OutputSink> sink, std::size_t chunk_size = CHUNK_SIZE,
+                       std::size_t chunks_count = CHUNKS_COUNT);
+    ~AsyncSink() override;
+
+    AsyncSink(const AsyncSink&) = delete;
+    AsyncSink& operator=(const AsyncSink&) = delete;
+
+    void Write(std::span<const std::uint8_t> data) override;
+    // Writes everything collected so far and rethrows the first error of the wrapped sink.
+    void Close();
+
+private:
+    std::unique_ptr<OutputSink> sink_;
+    std::size_t chunk_size_;
+    std::vector<std::vector<std::uint8_t>> chunks_;
+
+    std::size_t queued_ = 0;
+    std::size_t written_ = 0;
+    bool closed_ = false;
+    std::exception_ptr error_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread writer_;
+
+    void Submit();
+    void Run();
+};
+
+#endif  // ARCHIVER_OUTPUT_SINK_
@@ -5,12 +5,16 @@
 #include <cstddef>
 #include <functional>
 #include <initializer_list>
+#include <limits>
+#include <utility>
 #include <vector>
 
 #include "exceptions.h"
 
-template <typename T, typename Comparator = std::less<T>, typename Container = std::vector<T>>
+template <typename T, typename Comparator = std::less<T>, typename Container = std::vector<T>, std::size_t Arity = 4>
 class PriorityQueue {
+    static_assert(Arity >= 2);
+
 public:
     class QueueIsEmpty : public std::exception {};
 
@@ -18,10 +22,8 @@ public:
     }
 
     template <typename It>
-    PriorityQueue(It begin, It end, const Comparator& cmp = Comparator()) : cmp_(cmp) {
-        for (auto it = begin; it != end; ++it) {
-            Push(*it);
-        }
+    PriorityQueue(It begin, It end, const Comparator& cmp = Comparator()) : heap_(begin, end), cmp_(cmp) {
+        MakeHeap();
     }
 
     PriorityQueue(std::initializer_list<T> data, const Comparator& cmp = Comparator())
@@ -39,14 +41,35 @@ public:
         if (IsEmpty()) {
             return;
         }
-        std::swap(heap_[0], heap_[Size() - 1]);
+        PopTop();
+    }
+
+    T PopTop() {
+        if (IsEmpty()) {
+            throw QueueIsEmpty();
+        }
+        T top = std::move(heap_[0]);
+        T last = std::move(heap_.back());
         heap_.pop_back();
-        HeapifyDown(0);
+        if (!IsEmpty()) {
+            SiftDown(0, std::move(last));
+        }
+        return top;
     }
 
     void Push(const T& value) {
-        heap_.push_back(value);
-        HeapifyUp(Size() - 1);
+        Emplace(value);
+    }
+
+    void Push(T&& value) {
+        Emplace(std::move(value));
+    }
+
+    template <typename... Args>
+    void Emplace(Args&&... args) {
+        heap_.emplace_back(std::forward<Args>(args)...);
+        T value = std::move(heap_.back());
+        SiftUp(Size() - 1, std::move(value));
     }
 
     std::size_t Size() const {
@@ -63,43 +86,182 @@ private:
     Container heap_;
     Comparator cmp_;
 
-    static std::size_t LeftChild(std::size_t node) {
-        return 2 * node + 1;
+    static std::size_t FirstChild(std::size_t node) {
+        return Arity * node + 1;
     }
 
-    static std::size_t RightChild(std::size_t node) {
-        return 2 * node + 2;
+    static std::size_t Parent(std::size_t node) {
+        return (node - 1) / Arity;
     }
 
-    static std::size_t Parent(std::size_t node) {
-        return (node - 1) / 2;
+    void MakeHeap() {
+        if (Size() < 2) {
+            return;
+        }
+        for (std::size_t node = Parent(Size() - 1) + 1; node-- > 0;) {
+            T value = std::move(heap_[node]);
+            SiftDown(node, std::move(value));
+        }
+    }
+
+    void SiftDown(std::size_t node, T value) {
+        while (true) {
+            std::size_t first = FirstChild(node);
+            if (first >= Size()) {
+                break;
+            }
+            std::size_t last = std::min(first + Arity, Size());
+            std::size_t best = first;
+            for (std::size_t child = first + 1; child < last; ++child) {
+                if (cmp_(heap_[best], heap_[child])) {
+                    best = child;
+                }
+            }
+            if (!cmp_(value, heap_[best])) {
+                break;
+            }
+            heap_[node] = std::move(heap_[best]);
+            node = best;
+        }
+        heap_[node] = std::move(value);
+    }
+
+    void SiftUp(std::size_t node, T value) {
+        while (node > 0) {
+            std::size_t parent = Parent(node);
+            if (!cmp_(heap_[parent], value)) {
+                break;
+            }
+            heap_[node] = std::move(heap_[parent]);
+            node = parent;
+        }
+        heap_[node] = std::move(value);
+    }
+};
+
+template <typename T, typename Comparator = std::greater<T>, std::size_t Arity = 4>
+class IndexedPriorityQueue {
+    static_assert(Arity >= 2);
+
+public:
+    class QueueIsEmpty : public std::exception {};
+    class InvalidIndex : public std::exception {};
+
+    explicit IndexedPriorityQueue(std::size_t capacity, const Comparator& cmp = Comparator())
+        : keys_(capacity), positions_(capacity, NONE), cmp_(cmp) {
+    }
+
+    bool Contains(std::size_t index) const {
+        return index < positions_.size() && positions_[index] != NONE;
+    }
+
+    const T& Key(std::size_t index) const {
+        if (!Contains(index)) {
+            throw InvalidIndex();
+        }
+        return keys_[index];
     }
 
-    void HeapifyDown(std::size_t node) {
-        std::size_t left = LeftChild(node);
-        std::size_t right = RightChild(node);
-        std::size_t max = node;
+    std::size_t Top() const {
+        if (IsEmpty()) {
+            throw QueueIsEmpty();
+        }
+        return heap_[0];
+    }
 
-        if (left < Size() && cmp_(heap_[max], heap_[left])) {
-            max = left;
+    std::size_t PopTop() {
+        std::size_t top = Top();
+        Swap(0, Size() - 1);
+        heap_.pop_back();
+        positions_[top] = NONE;
+        if (!IsEmpty()) {
+            SiftDown(0);
         }
-        if (right < Size() && cmp_(heap_[max], heap_[right])) {
-            max = right;
+        return top;
+    }
+
+    void Push(std::size_t index, T key) {
+        if (index >= positions_.size() || Contains(index)) {
+            throw InvalidIndex();
         }
-        if (max != node) {
-            std::swap(heap_[max], heap_[node]);
-            HeapifyDown(max);
+        keys_[index] = std::move(key);
+        positions_[index] = Size();
+        heap_.push_back(index);
+        SiftUp(Size() - 1);
+    }
+
+    // Moves the element towards the top: with the default comparator the new key must not be greater.
+    void DecreaseKey(std::size_t index, T key) {
+        if (!Contains(index) || cmp_(key, keys_[index])) {
+            throw InvalidIndex();
         }
+        keys_[index] = std::move(key);
+        SiftUp(positions_[index]);
     }
 
-    void HeapifyUp(std::size_t node) {
-        if (node == 0) {
-            return;
+    void ChangeKey(std::size_t index, T key) {
+        if (!Contains(index)) {
+            throw InvalidIndex();
         }
-        std::size_t parent = Parent(node);
-        if (cmp_(heap_[parent], heap_[node])) {
-            std::swap(heap_[parent], heap_[node]);
-            HeapifyUp(parent);
+        keys_[index] = std::move(key);
+        SiftUp(positions_[index]);
+        SiftDown(positions_[index]);
+    }
+
+    std::size_t Size() const {
+        return heap_.size();
+    }
+    bool IsEmpty() const {
+        return Size() == 0;
+    }
+
+private:
+    const static std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    std::vector<std::size_t> heap_;
+    std::vector<T> keys_;
+    std::vector<std::size_t> positions_;
+    Comparator cmp_;
+
+    bool Less(std::size_t lhs, std::size_t rhs) const {
+        return cmp_(keys_[heap_[lhs]], keys_[heap_[rhs]]);
+    }
+
+    void Swap(std::size_t lhs, std::size_t rhs) {
+        std::swap(heap_[lhs], heap_[rhs]);
+        positions_[heap_[lhs]] = lhs;
+        positions_[heap_[rhs]] = rhs;
+    }
+
+    void SiftDown(std::size_t node) {
+        while (true) {
+            std::size_t first = Arity * node + 1;
+            if (first >= Size()) {
+                return;
+            }
+            std::size_t last = std::min(first + Arity, Size());
+            std::size_t best = first;
+            for (std::size_t child = first + 1; child < last; ++child) {
+                if (Less(best, child)) {
+                    best = child;
+                }
+            }
+            if (!Less(node, best)) {
+                return;
+            }
+            Swap(node, best);
+            node = best;
+        }
+    }
+
+    void SiftUp(std::size_t node) {
+        while (node > 0) {
+            std::size_t parent = (node - 1) / Arity;
+            if (!Less(parent, node)) {
+                return;
+            }
+            Swap(parent, node);
+            node = parent;
         }
     }
 };
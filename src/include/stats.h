@@ -0,0 +1,101 @@
+#ifndef ARCHIVER_STATS_
+#define ARCHIVER_STATS_
+
+#include <time.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Building without ARCHIVER_STATS turns the timers and counters in the coders into dead code.
+#ifdef ARCHIVER_STATS
+const bool STATS_ENABLED = true;
+#else
+const bool STATS_ENABLED = false;
+#endif
+
+enum class Stage {
+    Total,
+    Open,
+    CountSymbols,
+    HuffmanEncoding,
+    CanonicalCodes,
+    Encode,
+    WriteFile,
+    ReadHeader,
+    GenerateTrie,
+    GenerateTable,
+    Decode,
+    WriteOutput,
+};
+
+const std::size_t STAGES_COUNT = static_cast<std::size_t>(Stage::WriteOutput) + 1;
+
+enum class StatsFormat { Text, Json };
+
+// CPU time of a stage is taken for the thread that runs it, only the total covers the whole process with its reader,
+// writer and pool threads. Stages that run on pool threads add up the time of every thread.
+struct StageTime {
+    std::uint64_t calls = 0;
+    std::chrono::nanoseconds wall{0};
+    std::chrono::nanoseconds cpu{0};
+};
+
+// Symbols and code bits are counted by the legacy coders only, they include the file names and end markers.
+struct Stats {
+    std::array<StageTime, STAGES_COUNT> stages{};
+    std::uint64_t files = 0;
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    std::uint64_t symbols = 0;
+    std::uint64_t code_bits = 0;
+};
+
+// Adds the time from construction to destruction to a stage, does nothing when stats is nullptr.
+class StageTimer {
+public:
+    StageTimer(Stats* stats, Stage stage)
+        : stats_(STATS_ENABLED ? stats : nullptr),
+          stage_(stage),
+          cpu_clock_(stage == Stage::Total ? CLOCK_PROCESS_CPUTIME_ID : CLOCK_THREAD_CPUTIME_ID) {
+        if (stats_) {
+            wall_start_ = std::chrono::steady_clock::now();
+            cpu_start_ = CpuTime();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        if (stats_) {
+            StageTime& time = stats_->stages[static_cast<std::size_t>(stage_)];
+            ++time.calls;
+            time.wall += std::chrono::steady_clock::now() - wall_start_;
+            time.cpu += CpuTime() - cpu_start_;
+        }
+    }
+
+private:
+    Stats* stats_;
+    Stage stage_;
+    clockid_t cpu_clock_;
+    std::chrono::steady_clock::time_point wall_start_;
+    std::chrono::nanoseconds cpu_start_{0};
+
+    std::chrono::nanoseconds CpuTime() const {
+        timespec time{};
+        clock_gettime(cpu_clock_, &time);
+        return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+    }
+};
+
+// Adds the counters and stage times of other, such as those a pool task collected, to stats.
+void MergeStats(Stats& stats, const Stats& other);
+
+// Stages that never ran are left out.
+void PrintStats(std::ostream& os, const Stats& stats, StatsFormat format = StatsFormat::Text);
+
+#endif  // ARCHIVER_STATS_
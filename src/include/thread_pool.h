@@ -0,0 +1,59 @@
+#ifndef ARCHIVER_THREAD_POOL_
+#define ARCHIVER_THREAD_POOL_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Every worker has its own queue and steals from the others when it runs dry. Tasks submitted by a worker go to its
+// own queue, other tasks are spread round-robin. Idle workers sleep on one condition variable, whose lock a push takes
+// only while some worker sleeps.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Submit(F&& task) {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+        auto result = packaged->get_future();
+        Push([packaged] { (*packaged)(); });
+        return result;
+    }
+
+    std::size_t Size() const;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> next_queue_ = 0;
+
+    std::mutex idle_mutex_;
+    std::condition_variable idle_condition_;
+    // Changed under idle_mutex_, read without it by Push.
+    std::atomic<std::size_t> sleeping_ = 0;
+    std::size_t wakeups_ = 0;
+    bool stopped_ = false;
+
+    void Push(std::function<void()> task);
+    std::function<void()> Take(std::size_t index);
+    void Work(std::size_t index);
+};
+
+#endif  // ARCHIVER_THREAD_POOL_
@@ -0,0 +1,223 @@
+#include "input_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#include "exceptions.h"
+
+MemorySource::MemorySource(std::span<const std::uint8_t> data) : data_(data) {
+}
+
+std::span<const std::uint8_t> MemorySource::Next() {
+    if (consumed_) {
+        return {};
+    }
+    consumed_ = true;
+    return data_;
+}
+
+void MemorySource::Rewind() {
+    consumed_ = false;
+}
+
+StreamSource::StreamSource(std::istream& is, std::size_t chunk_size) : is_(is), buffer_(chunk_size) {
+}
+
+StreamSource::StreamSource(Path filename, std::size_t chunk_size)
+    : file_(std::make_unique<std::ifstream>(filename, std::ios::binary)), is_(*file_), buffer_(chunk_size) {
+    if (!file_->is_open()) {
+        throw InputError();
+    }
+}
+
+std::span<const std::uint8_t> StreamSource::Next() {
+    if (is_.eof()) {
+        return {};
+    }
+    is_.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+    if (is_.bad()) {
+        throw InputError();
+    }
+    return {buffer_.data(), static_cast<std::size_t>(is_.gcount())};
+}
+
+void StreamSource::Rewind() {
+    is_.clear();
+    is_.seekg(0);
+    if (is_.fail()) {
+        throw InputError();
+    }
+}
+
+MappedSource::MappedSource(Path filename) : fd_(open(filename.c_str(), O_RDONLY)) {
+    struct stat info {};
+    if (fd_ < 0 || fstat(fd_, &info) != 0 || !S_ISREG(info.st_mode)) {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw InputError();
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+}
+
+MappedSource::~MappedSource() {
+    Unmap();
+    close(fd_);
+}
+
+void MappedSource::Unmap() {
+    if (window_ != nullptr) {
+        munmap(window_, window_size_);
+        window_ = nullptr;
+        window_size_ = 0;
+    }
+}
+
+std::span<const std::uint8_t> MappedSource::Next() {
+    Unmap();
+    if (offset_ >= size_) {
+        return {};
+    }
+    std::size_t length = std::min(WINDOW_SIZE, size_ - offset_);
+    void* window = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(offset_));
+    if (window == MAP_FAILED) {
+        throw InputError();
+    }
+    madvise(window, length, MADV_SEQUENTIAL);
+    window_ = window;
+    window_size_ = length;
+    offset_ += length;
+    return {static_cast<const std::uint8_t*>(window_), window_size_};
+}
+
+void MappedSource::Rewind() {
+    Unmap();
+    offset_ = 0;
+}
+
+PrefetchSource::PrefetchSource(std::unique_ptr<InputSource> source, std::size_t chunk_size,
+                               std::size_t chunks_count)
+    : source_(std::move(source)), chunk_size_(chunk_size == 0 ? CHUNK_SIZE : chunk_size), chunks_(chunks_count) {
+    Start();
+}
+
+PrefetchSource::~PrefetchSource() {
+    Stop();
+}
+
+void PrefetchSource::Start() {
+    filled_ = 0;
+    consumed_ = 0;
+    holding_ = false;
+    finished_ = false;
+    stopped_ = false;
+    error_ = nullptr;
+    reader_ = std::thread(&PrefetchSource::Read, this);
+}
+
+void PrefetchSource::Stop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopped_ = true;
+    }
+    condition_.notify_all();
+    reader_.join();
+}
+
+void PrefetchSource::Read() {
+    try {
+        std::span<const std::uint8_t> pending;
+        bool exhausted = false;
+        while (!exhausted) {
+            {
+                std::unique_lock lock(mutex_);
+                condition_.wait(lock, [this] { return stopped_ || filled_ - consumed_ < chunks_.size(); });
+                if (stopped_) {
+                    return;
+                }
+            }
+            std::vector<std::uint8_t>& chunk = chunks_[filled_ % chunks_.size()];
+            chunk.clear();
+            while (chunk.size() < chunk_size_) {
+                if (pending.empty()) {
+                    pending = source_->Next();
+                    if (pending.empty()) {
+                        exhausted = true;
+                        break;
+                    }
+                }
+                std::size_t count = std::min(pending.size(), chunk_size_ - chunk.size());
+                chunk.insert(chunk.end(), pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(count));
+                pending = pending.subspan(count);
+            }
+            {
+                std::lock_guard lock(mutex_);
+                filled_ += !chunk.empty();
+                finished_ = exhausted;
+            }
+            condition_.notify_all();
+        }
+    } catch (...) {
+        {
+            std::lock_guard lock(mutex_);
+            error_ = std::current_exception();
+            finished_ = true;
+        }
+        condition_.notify_all();
+    }
+}
+
+std::span<const std::uint8_t> PrefetchSource::Next() {
+    std::unique_lock lock(mutex_);
+    if (holding_) {
+        ++consumed_;
+        holding_ = false;
+        condition_.notify_all();
+    }
+    condition_.wait(lock, [this] { return finished_ || filled_ > consumed_; });
+    if (filled_ > consumed_) {
+        holding_ = true;
+        return chunks_[consumed_ % chunks_.size()];
+    }
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    return {};
+}
+
+void PrefetchSource::Rewind() {
+    Stop();
+    source_->Rewind();
+    Start();
+}
+
+std::unique_ptr<InputSource> OpenSource(Path filename) {
+    if (filename == STANDARD_STREAM) {
+        return std::make_unique<StreamSource>(std::cin);
+    }
+    if (std::filesystem::is_regular_file(filename)) {
+        try {
+            return std::make_unique<MappedSource>(filename);
+        } catch (const InputError& ex) {
+        }
+    }
+    return std::make_unique<StreamSource>(filename);
+}
+
+std::unique_ptr<InputSource> OpenPrefetchSource(Path filename, std::size_t chunk_size) {
+    if (chunk_size == 0) {
+        chunk_size = PrefetchSource::CHUNK_SIZE;
+    }
+    if (IsSeekable(filename) && std::filesystem::file_size(filename) <= chunk_size) {
+        return OpenSource(filename);
+    }
+    return std::make_unique<PrefetchSource>(OpenSource(filename), chunk_size);
+}
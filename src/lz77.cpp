@@ -0,0 +1,185 @@
+#include "lz77.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const std::size_t HASH_BITS = 16;
+const std::size_t FAR_DISTANCE = 1 << 12;
+const std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+// Lazy search is skipped after a match of lazy_size bytes, and a match of good_size bytes shortens it.
+struct LevelParameters {
+    std::size_t chain_size;
+    std::size_t nice_size;
+    std::size_t lazy_size;
+    std::size_t good_size;
+};
+
+const std::array<LevelParameters, MAX_LEVEL> LEVELS = {{
+    {4, 8, 0, 4},
+    {8, 16, 0, 4},
+    {32, 32, 0, 4},
+    {16, 16, 4, 4},
+    {32, 32, 16, 8},
+    {128, 128, 16, 8},
+    {256, 128, 32, 8},
+    {1024, MAX_MATCH_SIZE, 128, 32},
+    {4096, MAX_MATCH_SIZE, MAX_MATCH_SIZE, 32},
+}};
+
+std::size_t CommonPrefix(const std::uint8_t* lhs, const std::uint8_t* rhs, std::size_t limit) {
+    std::size_t size = 0;
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; size + sizeof(std::uint64_t) <= limit; size += sizeof(std::uint64_t)) {
+            std::uint64_t first = 0;
+            std::uint64_t second = 0;
+            std::memcpy(&first, lhs + size, sizeof(first));
+            std::memcpy(&second, rhs + size, sizeof(second));
+            if (first != second) {
+                return size + std::countr_zero(first ^ second) / CHAR_BIT;
+            }
+        }
+    }
+    while (size < limit && lhs[size] == rhs[size]) {
+        ++size;
+    }
+    return size;
+}
+
+struct Match {
+    std::size_t size = 0;
+    std::size_t distance = 0;
+};
+
+class MatchFinder {
+public:
+    MatchFinder(std::span<const std::uint8_t> data, const Lz77Options& options)
+        : data_(data),
+          window_size_(std::size_t{1} << options.window_bits),
+          parameters_(LEVELS[std::clamp(options.level, MIN_LEVEL, MAX_LEVEL) - 1]),
+          head_(std::size_t{1} << HASH_BITS, NONE),
+          previous_(std::min(window_size_, std::bit_ceil(std::max<std::size_t>(data.size(), 1))), NONE) {
+    }
+
+    const LevelParameters& Parameters() const {
+        return parameters_;
+    }
+
+    void Insert(std::size_t pos) {
+        if (pos + MIN_MATCH_SIZE > data_.size()) {
+            return;
+        }
+        std::uint32_t& head = head_[Hash(pos)];
+        previous_[pos & (previous_.size() - 1)] = head;
+        head = static_cast<std::uint32_t>(pos);
+    }
+
+    Match Find(std::size_t pos, std::size_t previous_size = 0) const {
+        Match best;
+        if (pos + MIN_MATCH_SIZE > data_.size()) {
+            return best;
+        }
+        std::size_t chain = parameters_.chain_size;
+        if (previous_size >= parameters_.good_size) {
+            chain = std::max<std::size_t>(chain / 4, 1);
+        }
+        std::size_t limit = std::min(MAX_MATCH_SIZE, data_.size() - pos);
+        std::size_t window = std::min(window_size_, previous_.size());
+        std::uint32_t candidate = head_[Hash(pos)];
+        for (; candidate != NONE && chain > 0; --chain) {
+            std::size_t distance = pos - candidate;
+            if (distance >= window) {
+                break;
+            }
+            const std::uint8_t* current = data_.data() + pos;
+            const std::uint8_t* previous = data_.data() + candidate;
+            if (best.size == 0 || previous[best.size] == current[best.size]) {
+                std::size_t size = CommonPrefix(previous, current, limit);
+                if (size > best.size) {
+                    best = {size, distance};
+                    if (size >= std::min(parameters_.nice_size, limit)) {
+                        break;
+                    }
+                }
+            }
+            candidate = previous_[candidate & (previous_.size() - 1)];
+        }
+        if (best.size < MIN_MATCH_SIZE || (best.size == MIN_MATCH_SIZE && best.distance > FAR_DISTANCE)) {
+            return {};
+        }
+        return best;
+    }
+
+private:
+    std::span<const std::uint8_t> data_;
+    std::size_t window_size_;
+    LevelParameters parameters_;
+    std::vector<std::uint32_t> head_;
+    std::vector<std::uint32_t> previous_;
+
+    std::size_t Hash(std::size_t pos) const {
+        std::uint32_t value = data_[pos] | (data_[pos + 1] << 8) | (data_[pos + 2] << 16);
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+};
+
+}  // namespace
+
+ValueCode EncodeValue(std::size_t value) {
+    if (value < 4) {
+        return {value, 0, 0};
+    }
+    std::size_t bits = std::bit_width(value) - 1;
+    return {2 * bits + ((value >> (bits - 1)) & 1), bits - 1, value & ((std::size_t{1} << (bits - 1)) - 1)};
+}
+
+std::size_t ValueBase(std::size_t code) {
+    if (code < 4) {
+        return code;
+    }
+    return (2 | (code & 1)) << (code / 2 - 1);
+}
+
+std::size_t ValueExtraBits(std::size_t code) {
+    return code < 4 ? 0 : code / 2 - 1;
+}
+
+std::vector<Lz77Token> FindMatches(std::span<const std::uint8_t> data, const Lz77Options& options) {
+    MatchFinder finder(data, options);
+    const LevelParameters& parameters = finder.Parameters();
+    std::vector<Lz77Token> tokens;
+    tokens.reserve(data.size() / 2);
+
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        Match match = finder.Find(pos);
+        finder.Insert(pos);
+        while (match.size > 0 && match.size < parameters.lazy_size) {
+            Match next = finder.Find(pos + 1, match.size);
+            if (next.size <= match.size) {
+                break;
+            }
+            tokens.push_back({0, 0, data[pos]});
+            finder.Insert(++pos);
+            match = next;
+        }
+        if (match.size == 0) {
+            tokens.push_back({0, 0, data[pos]});
+            ++pos;
+            continue;
+        }
+        tokens.push_back({static_cast<std::uint32_t>(match.distance), static_cast<std::uint16_t>(match.size), 0});
+        for (std::size_t end = pos + match.size; ++pos < end;) {
+            finder.Insert(pos);
+        }
+    }
+    return tokens;
+}
@@ -0,0 +1,110 @@
+#include "block_codec.h"
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bit_stream.h"
+#include "constants.h"
+#include "decode_table.h"
+#include "exceptions.h"
+#include "huffman.h"
+#include "input_source.h"
+#include "lz77.h"
+#include "output_sink.h"
+
+namespace {
+
+const std::size_t BYTE_VALUES = 1 << CHAR_BIT;
+
+void WriteValue(BitWriter& output, const CodeTable& codes, Char offset, std::size_t value) {
+    ValueCode value_code = EncodeValue(value);
+    const Code& code = codes[offset + value_code.code];
+    output.WriteWord(code.code, code.size);
+    output.WriteWord(value_code.extra, value_code.extra_bits);
+}
+
+std::size_t ReadValue(BitReader& input, std::size_t code) {
+    return ValueBase(code) + input.ReadBits<std::size_t>(ValueExtraBits(code));
+}
+
+}  // namespace
+
+EncodedBlock EncodeLz77Block(std::span<const std::uint8_t> data, const Lz77Options& options,
+                             std::size_t max_code_size) {
+    std::vector<Lz77Token> tokens = FindMatches(data, options);
+    SymbolsCount symbols_count{};
+    SymbolsCount distances_count{};
+    for (const Lz77Token& token : tokens) {
+        if (token.size == 0) {
+            ++symbols_count[token.literal];
+        } else {
+            ++symbols_count[FIRST_MATCH_CODE + EncodeValue(token.size - MIN_MATCH_SIZE).code];
+            ++distances_count[EncodeValue(token.distance - 1).code];
+        }
+    }
+    std::size_t limit = max_code_size == 0 ? MAX_CODE_SIZE : max_code_size;
+    CodeSizes sizes = LimitedHuffmanEncoding(symbols_count, limit);
+    CodeSizes distance_sizes = LimitedHuffmanEncoding(distances_count, limit);
+    CodeTable codes = CanonicalCodes(sizes);
+    CodeTable distance_codes = CanonicalCodes(distance_sizes);
+
+    EncodedBlock block{data.size(), {}};
+    MemorySink sink(block.payload);
+    BitWriter output(sink);
+    WriteCompactCodeSizes(output, sizes);
+    WriteCompactCodeSizes(output, distance_sizes);
+    for (const Lz77Token& token : tokens) {
+        if (token.size == 0) {
+            const Code& code = codes[token.literal];
+            output.WriteWord(code.code, code.size);
+        } else {
+            WriteValue(output, codes, FIRST_MATCH_CODE, token.size - MIN_MATCH_SIZE);
+            WriteValue(output, distance_codes, 0, token.distance - 1);
+        }
+    }
+    output.Flush();
+    return block;
+}
+
+void DecodeLz77Block(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) {
+    MemorySource source(payload);
+    BitReader input(source);
+    CodeSizes sizes = ReadCompactCodeSizes(input);
+    for (const auto& [key, size] : sizes) {
+        if (static_cast<std::size_t>(key) >= BYTE_VALUES && key < FIRST_MATCH_CODE) {
+            throw InvalidFormat();
+        }
+    }
+    CodeSizes distance_sizes = ReadCompactCodeSizes(input);
+    for (const auto& [key, size] : distance_sizes) {
+        if (static_cast<std::size_t>(key) >= DISTANCE_CODES_COUNT) {
+            throw InvalidFormat();
+        }
+    }
+    try {
+        DecodeTable table(CanonicalCodes(sizes));
+        DecodeTable distance_table(CanonicalCodes(distance_sizes));
+        std::size_t pos = 0;
+        while (pos < output.size()) {
+            Char symbol = table.Decode(input);
+            if (symbol < FIRST_MATCH_CODE) {
+                output[pos++] = static_cast<std::uint8_t>(symbol);
+                continue;
+            }
+            std::size_t size = MIN_MATCH_SIZE + ReadValue(input, symbol - FIRST_MATCH_CODE);
+            std::size_t distance = 1 + ReadValue(input, distance_table.Decode(input));
+            if (distance > pos || size > output.size() - pos) {
+                throw InvalidFormat();
+            }
+            for (std::size_t end = pos + size; pos < end; ++pos) {
+                output[pos] = output[pos - distance];
+            }
+        }
+    } catch (const DecodeTable::InvalidCode& ex) {
+        throw InvalidFormat();
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+}
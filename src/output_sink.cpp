@@ -0,0 +1,120 @@
+#include "output_sink.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "exceptions.h"
+
+StreamSink::StreamSink(std::ostream& os) : os_(os) {
+}
+
+void StreamSink::Write(std::span<const std::uint8_t> data) {
+    if (!os_.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+        throw OutputError();
+    }
+}
+
+MemorySink::MemorySink(std::vector<std::uint8_t>& data) : data_(data) {
+}
+
+void MemorySink::Write(std::span<const std::uint8_t> data) {
+    data_.insert(data_.end(), data.begin(), data.end());
+}
+
+AsyncSink::AsyncSink(std::unique_ptr<OutputSink> sink, std::size_t chunk_size, std::size_t chunks_count)
+    : sink_(std::move(sink)), chunk_size_(chunk_size == 0 ? CHUNK_SIZE : chunk_size), chunks_(chunks_count) {
+}
+
+AsyncSink::~AsyncSink() {
+    try {
+        Close();
+    } catch (...) {
+    }
+}
+
+void AsyncSink::Write(std::span<const std::uint8_t> data) {
+    while (!data.empty()) {
+        std::vector<std::uint8_t>& chunk = chunks_[queued_ % chunks_.size()];
+        if (chunk.capacity() < chunk_size_) {
+            chunk.reserve(chunk_size_);
+        }
+        std::size_t count = std::min(data.size(), chunk_size_ - chunk.size());
+        chunk.insert(chunk.end(), data.begin(), data.begin() + static_cast<std::ptrdiff_t>(count));
+        data = data.subspan(count);
+        if (chunk.size() == chunk_size_) {
+            Submit();
+        }
+    }
+}
+
+void AsyncSink::Submit() {
+    if (!writer_.joinable()) {
+        writer_ = std::thread(&AsyncSink::Run, this);
+    }
+    std::unique_lock lock(mutex_);
+    ++queued_;
+    condition_.notify_all();
+    condition_.wait(lock, [this] { return queued_ - written_ < chunks_.size(); });
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void AsyncSink::Run() {
+    while (true) {
+        std::size_t index = 0;
+        {
+            std::unique_lock lock(mutex_);
+            condition_.wait(lock, [this] { return closed_ || written_ < queued_; });
+            if (written_ == queued_) {
+                return;
+            }
+            index = written_ % chunks_.size();
+        }
+        std::exception_ptr error;
+        try {
+            if (!error_) {
+                sink_->Write(chunks_[index]);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        chunks_[index].clear();
+        {
+            std::lock_guard lock(mutex_);
+            ++written_;
+            if (error) {
+                error_ = error;
+            }
+        }
+        condition_.notify_all();
+    }
+}
+
+void AsyncSink::Close() {
+    std::vector<std::uint8_t>& chunk = chunks_[queued_ % chunks_.size()];
+    if (!writer_.joinable()) {
+        if (!chunk.empty()) {
+            sink_->Write(chunk);
+            chunk.clear();
+        }
+        return;
+    }
+    if (!chunk.empty()) {
+        try {
+            Submit();
+        } catch (...) {
+            // Kept in error_ and rethrown once the writer has stopped.
+        }
+    }
+    {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+    }
+    condition_.notify_all();
+    writer_.join();
+    closed_ = false;
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
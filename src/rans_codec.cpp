@@ -0,0 +1,171 @@
+#include "block_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bit_stream.h"
+#include "exceptions.h"
+#include "huffman.h"
+#include "input_source.h"
+#include "output_sink.h"
+
+namespace {
+
+const std::size_t BYTE_VALUES = 1 << CHAR_BIT;
+const std::size_t SCALE_BITS = 14;
+const std::uint32_t SCALE = std::uint32_t{1} << SCALE_BITS;
+const std::uint32_t LOWER_BOUND = std::uint32_t{1} << 23;
+const std::size_t STREAMS_COUNT = 4;
+const std::size_t STATE_BYTES = sizeof(std::uint32_t);
+const std::size_t SYMBOLS_COUNT_BITS = 9;
+
+using Frequencies = std::array<std::uint32_t, BYTE_VALUES>;
+
+Frequencies Normalize(const SymbolsCount& symbols_count, std::size_t total) {
+    Frequencies frequencies{};
+    std::uint64_t sum = 0;
+    std::size_t most_frequent = 0;
+    for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+        if (symbols_count[c] == 0) {
+            continue;
+        }
+        std::uint64_t scaled = static_cast<std::uint64_t>(symbols_count[c]) * SCALE / total;
+        frequencies[c] = static_cast<std::uint32_t>(std::max<std::uint64_t>(scaled, 1));
+        sum += frequencies[c];
+        if (symbols_count[c] > symbols_count[most_frequent]) {
+            most_frequent = c;
+        }
+    }
+    if (sum < SCALE) {
+        frequencies[most_frequent] += static_cast<std::uint32_t>(SCALE - sum);
+    }
+    while (sum > SCALE) {
+        auto largest = std::max_element(frequencies.begin(), frequencies.end());
+        std::uint32_t reduce = static_cast<std::uint32_t>(std::min<std::uint64_t>(sum - SCALE, *largest - 1));
+        *largest -= reduce;
+        sum -= reduce;
+    }
+    return frequencies;
+}
+
+Frequencies StartsOf(const Frequencies& frequencies) {
+    Frequencies starts{};
+    std::uint32_t start = 0;
+    for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+        starts[c] = start;
+        start += frequencies[c];
+    }
+    return starts;
+}
+
+}  // namespace
+
+EncodedBlock EncodeRansBlock(std::span<const std::uint8_t> data) {
+    SymbolsCount symbols_count{};
+    CountBytes(data, symbols_count);
+    Frequencies frequencies = Normalize(symbols_count, data.size());
+    Frequencies starts = StartsOf(frequencies);
+
+    EncodedBlock block{data.size(), {}};
+    {
+        MemorySink sink(block.payload);
+        BitWriter output(sink);
+        std::size_t present = std::count_if(frequencies.begin(), frequencies.end(), [](auto f) { return f > 0; });
+        output.WriteBits(present, SYMBOLS_COUNT_BITS);
+        for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+            if (frequencies[c] > 0) {
+                output.WriteBits(c, CHAR_BIT);
+                output.WriteBits(frequencies[c] - 1, SCALE_BITS);
+            }
+        }
+    }
+
+    std::vector<std::uint8_t> stream;
+    stream.reserve(data.size() + STREAMS_COUNT * STATE_BYTES);
+    std::array<std::uint32_t, STREAMS_COUNT> states;
+    states.fill(LOWER_BOUND);
+    for (std::size_t i = data.size(); i-- > 0;) {
+        std::uint32_t& state = states[i % STREAMS_COUNT];
+        std::uint32_t frequency = frequencies[data[i]];
+        std::uint32_t limit = ((LOWER_BOUND >> SCALE_BITS) << CHAR_BIT) * frequency;
+        while (state >= limit) {
+            stream.push_back(static_cast<std::uint8_t>(state));
+            state >>= CHAR_BIT;
+        }
+        state = ((state / frequency) << SCALE_BITS) + state % frequency + starts[data[i]];
+    }
+    for (std::size_t k = STREAMS_COUNT; k-- > 0;) {
+        for (std::size_t byte = 0; byte < STATE_BYTES; ++byte) {
+            stream.push_back(static_cast<std::uint8_t>(states[k] >> (byte * CHAR_BIT)));
+        }
+    }
+    block.payload.insert(block.payload.end(), stream.rbegin(), stream.rend());
+    return block;
+}
+
+void DecodeRansBlock(std::span<const std::uint8_t> payload, std::span<std::uint8_t> output) {
+    Frequencies frequencies{};
+    std::size_t table_size = 0;
+    try {
+        MemorySource source(payload);
+        BitReader input(source);
+        std::size_t present = input.ReadBits<std::size_t>(SYMBOLS_COUNT_BITS);
+        if (present > BYTE_VALUES) {
+            throw InvalidFormat();
+        }
+        std::uint32_t sum = 0;
+        for (std::size_t i = 0; i < present; ++i) {
+            auto c = input.ReadBits<std::uint8_t>(CHAR_BIT);
+            if (frequencies[c] > 0) {
+                throw InvalidFormat();
+            }
+            frequencies[c] = input.ReadBits<std::uint32_t>(SCALE_BITS) + 1;
+            sum += frequencies[c];
+        }
+        if (sum != SCALE) {
+            throw InvalidFormat();
+        }
+        input.AlignToByte();
+        table_size = input.Position() / CHAR_BIT;
+    } catch (const BitReader::EndOfFile& ex) {
+        throw InvalidFormat();
+    }
+
+    Frequencies starts = StartsOf(frequencies);
+    std::vector<std::uint8_t> slots(SCALE);
+    for (std::size_t c = 0; c < BYTE_VALUES; ++c) {
+        std::fill_n(slots.begin() + starts[c], frequencies[c], static_cast<std::uint8_t>(c));
+    }
+
+    std::span<const std::uint8_t> stream = payload.subspan(table_size);
+    if (stream.size() < STREAMS_COUNT * STATE_BYTES) {
+        throw InvalidFormat();
+    }
+    std::size_t pos = 0;
+    std::array<std::uint32_t, STREAMS_COUNT> states{};
+    for (std::uint32_t& state : states) {
+        for (std::size_t byte = 0; byte < STATE_BYTES; ++byte) {
+            state = (state << CHAR_BIT) | stream[pos++];
+        }
+    }
+    for (std::size_t i = 0; i < output.size(); ++i) {
+        std::uint32_t& state = states[i % STREAMS_COUNT];
+        std::uint32_t slot = state & (SCALE - 1);
+        std::uint8_t c = slots[slot];
+        state = frequencies[c] * (state >> SCALE_BITS) + slot - starts[c];
+        while (state < LOWER_BOUND) {
+            if (pos == stream.size()) {
+                throw InvalidFormat();
+            }
+            state = (state << CHAR_BIT) | stream[pos++];
+        }
+        output[i] = c;
+    }
+    if (pos != stream.size() || std::any_of(states.begin(), states.end(), [](auto s) { return s != LOWER_BOUND; })) {
+        throw InvalidFormat();
+    }
+}
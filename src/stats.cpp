@@ -0,0 +1,96 @@
+#include "stats.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string_view>
+
+namespace {
+
+const std::array<std::string_view, STAGES_COUNT> STAGE_NAMES = {
+    "total",      "open",        "count_symbols", "huffman_encoding", "canonical_codes", "encode",
+    "write_file", "read_header", "generate_trie", "generate_table",   "decode",          "write_output",
+};
+
+const int NAME_WIDTH = 20;
+const int VALUE_WIDTH = 12;
+
+double Seconds(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double>(time).count();
+}
+
+double AverageCodeLength(const Stats& stats) {
+    return stats.symbols == 0 ? 0 : static_cast<double>(stats.code_bits) / static_cast<double>(stats.symbols);
+}
+
+void PrintText(std::ostream& os, const Stats& stats) {
+    auto print_counter = [&](std::string_view name, std::uint64_t value) {
+        os << std::left << std::setw(NAME_WIDTH) << name << std::right << std::setw(VALUE_WIDTH) << value << '\n';
+    };
+    print_counter("files", stats.files);
+    print_counter("bytes in", stats.bytes_in);
+    print_counter("bytes out", stats.bytes_out);
+    if (stats.symbols > 0) {
+        print_counter("symbols", stats.symbols);
+        os << std::left << std::setw(NAME_WIDTH) << "average code length" << std::right << std::fixed
+           << std::setprecision(3) << std::setw(VALUE_WIDTH) << AverageCodeLength(stats) << " bits\n";
+    }
+    os << std::left << std::setw(NAME_WIDTH) << "stage" << std::right << std::setw(VALUE_WIDTH) << "calls"
+       << std::setw(VALUE_WIDTH) << "wall, s" << std::setw(VALUE_WIDTH) << "cpu, s" << '\n';
+    for (std::size_t i = 0; i < STAGES_COUNT; ++i) {
+        const StageTime& time = stats.stages[i];
+        if (time.calls == 0) {
+            continue;
+        }
+        os << std::left << std::setw(NAME_WIDTH) << STAGE_NAMES[i] << std::right << std::setw(VALUE_WIDTH)
+           << time.calls << std::fixed << std::setprecision(6) << std::setw(VALUE_WIDTH) << Seconds(time.wall)
+           << std::setw(VALUE_WIDTH) << Seconds(time.cpu) << '\n';
+    }
+}
+
+void PrintJson(std::ostream& os, const Stats& stats) {
+    os << "{\"files\": " << stats.files << ", \"bytes_in\": " << stats.bytes_in << ", \"bytes_out\": "
+       << stats.bytes_out << ", \"symbols\": " << stats.symbols << ", \"average_code_length\": " << std::fixed
+       << std::setprecision(6) << AverageCodeLength(stats) << ", \"stages\": {";
+    bool first = true;
+    for (std::size_t i = 0; i < STAGES_COUNT; ++i) {
+        const StageTime& time = stats.stages[i];
+        if (time.calls == 0) {
+            continue;
+        }
+        os << (first ? "" : ", ") << '"' << STAGE_NAMES[i] << "\": {\"calls\": " << time.calls
+           << ", \"wall_seconds\": " << Seconds(time.wall) << ", \"cpu_seconds\": " << Seconds(time.cpu) << '}';
+        first = false;
+    }
+    os << "}}\n";
+}
+
+}  // namespace
+
+void MergeStats(Stats& stats, const Stats& other) {
+    for (std::size_t i = 0; i < STAGES_COUNT; ++i) {
+        stats.stages[i].calls += other.stages[i].calls;
+        stats.stages[i].wall += other.stages[i].wall;
+        stats.stages[i].cpu += other.stages[i].cpu;
+    }
+    stats.files += other.files;
+    stats.bytes_in += other.bytes_in;
+    stats.bytes_out += other.bytes_out;
+    stats.symbols += other.symbols;
+    stats.code_bits += other.code_bits;
+}
+
+void PrintStats(std::ostream& os, const Stats& stats, StatsFormat format) {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    if (format == StatsFormat::Json) {
+        PrintJson(os, stats);
+    } else {
+        PrintText(os, stats);
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -1,13 +1,37 @@
 #include <catch.hpp>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <initializer_list>
+#include <iomanip>
+#include <memory>
+#include <numeric>
+#include <random>
 #include <string_view>
+#include <thread>
 #include <sstream>
 
+#include "archive_format.h"
 #include "argument_parser.h"
 #include "binary_trie.h"
 #include "bit_stream.h"
+#include "block_codec.h"
+#include "checksum.h"
+#include "decode_table.h"
+#include "dedup.h"
+#include "dictionary.h"
+#include "exceptions.h"
+#include "files.h"
+#include "huffman.h"
+#include "input_source.h"
+#include "lz77.h"
+#include "output_sink.h"
 #include "priority_queue.h"
+#include "stats.h"
+#include "thread_pool.h"
 
 std::pair<int, char**> GenerateArgv(std::initializer_list<std::string> args) {
     int argc = static_cast<int>(args.size());
@@ -68,6 +92,23 @@ TEST_CASE("ArgumentParser") {
         }
         ClearArgv(argc, argv);
     }
+    argument_parser.AddOption("-j", "threads", "-j N", true);
+    {
+        auto [argc, argv] = GenerateArgv({"test", "-j", "4", "-h", "-", "hello"});
+        auto parsed_arguments = argument_parser.ParseArguments(argc, argv);
+        REQUIRE(parsed_arguments.values.at("-j") == "4");
+        REQUIRE(parsed_arguments.positional_arguments == std::vector<std::string>{"-", "hello"});
+        ClearArgv(argc, argv);
+    }
+    {
+        auto [argc, argv] = GenerateArgv({"test", "-h", "-j"});
+        try {
+            argument_parser.ParseArguments(argc, argv);
+            REQUIRE(false);
+        } catch (const ParsingError& ex) {
+        }
+        ClearArgv(argc, argv);
+    }
 }
 
 TEST_CASE("BitReader") {
@@ -99,8 +140,28 @@ TEST_CASE("BitReader") {
             ss.put(0b11110000);
         }
         for (std::size_t i = 0; i < 2500; ++i) {
-            reader.ReadBits<int>(16);
+            REQUIRE(reader.ReadBits<int>(16) == 0b0010101111110000);
+        }
+        REQUIRE(reader.Eof());
+    }
+    {
+        std::stringstream ss;
+        BitReader reader(ss);
+        ss.put(0b10110011);
+        ss.put(0b01011100);
+        REQUIRE(reader.PeekBits(3) == 0b101);
+        REQUIRE(reader.PeekBits(12) == 0b101100110101);
+        reader.ConsumeBits(3);
+        REQUIRE(reader.PeekBits(5) == 0b10011);
+        reader.ConsumeBits(10);
+        REQUIRE(reader.PeekBits(8) == 0b10000000);
+        try {
+            reader.ConsumeBits(4);
+            REQUIRE(false);
+        } catch (const BitReader::EndOfFile& ex) {
         }
+        reader.ConsumeBits(3);
+        REQUIRE(reader.Eof());
     }
 }
 
@@ -132,48 +193,192 @@ TEST_CASE("BitWriter") {
             }
         }
         for (std::size_t i = 0; i < 2500; ++i) {
-            ss.get();
-            ss.get();
+            REQUIRE(ss.get() == 0b00101011);
+            REQUIRE(ss.get() == 0b11110000);
+        }
+    }
+    {
+        std::stringstream ss;
+        {
+            BitWriter writer(ss);
+            writer.WriteBits<std::uint64_t>(0xFEDCBA9876543210, 64);
+            writer.WriteBits(0b101, 3);
+            writer.WriteBits<std::uint64_t>(0x0123456789ABCDEF, 64);
         }
+        BitReader reader(ss);
+        REQUIRE(reader.ReadBits<std::uint64_t>(64) == 0xFEDCBA9876543210);
+        REQUIRE(reader.ReadBits<int>(3) == 0b101);
+        REQUIRE(reader.ReadBits<std::uint64_t>(64) == 0x0123456789ABCDEF);
+        REQUIRE(reader.ReadBits<int>(5) == 0);
+        REQUIRE(reader.Eof());
+    }
+}
+
+TEST_CASE("InputSource") {
+    auto read_all = [](InputSource& source) {
+        std::string data;
+        for (auto chunk = source.Next(); !chunk.empty(); chunk = source.Next()) {
+            data.append(chunk.begin(), chunk.end());
+        }
+        return data;
+    };
+    std::string expected;
+    for (std::size_t i = 0; i < 10000; ++i) {
+        expected += static_cast<char>(i * 7 % 256);
+    }
+    Path filename = std::filesystem::temp_directory_path() / "archiver_input_source_test";
+    std::ofstream(filename, std::ios::binary) << expected;
+    {
+        MappedSource source(filename);
+        REQUIRE(read_all(source) == expected);
+        source.Rewind();
+        REQUIRE(read_all(source) == expected);
+    }
+    {
+        StreamSource source(filename, 1000);
+        REQUIRE(source.Next().size() == 1000);
+        source.Rewind();
+        REQUIRE(read_all(source) == expected);
+    }
+    {
+        auto source = OpenSource(filename);
+        BitReader reader(*source);
+        for (char c : expected) {
+            REQUIRE(reader.ReadBits<char>(8) == c);
+        }
+        REQUIRE(reader.Eof());
+    }
+    {
+        PrefetchSource source(std::make_unique<StreamSource>(filename, 777), 1000, 3);
+        REQUIRE(source.Next().size() == 1000);
+        REQUIRE(read_all(source) == expected.substr(1000));
+        source.Rewind();
+        REQUIRE(read_all(source) == expected);
+        REQUIRE(read_all(*OpenPrefetchSource(filename, 4096)) == expected);
+    }
+    std::ofstream(filename, std::ios::binary | std::ios::trunc);
+    {
+        MappedSource source(filename);
+        REQUIRE(source.Next().empty());
+    }
+    std::filesystem::remove(filename);
+    try {
+        MappedSource source(filename);
+        REQUIRE(false);
+    } catch (const InputError& ex) {
+    }
+}
+
+TEST_CASE("AsyncSink") {
+    class FailingSink : public OutputSink {
+    public:
+        void Write(std::span<const std::uint8_t>) override {
+            throw OutputError();
+        }
+    };
+
+    std::vector<std::uint8_t> expected(100000);
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        expected[i] = static_cast<std::uint8_t>(i * 13 % 251);
+    }
+    std::vector<std::uint8_t> data;
+    {
+        AsyncSink sink(std::make_unique<MemorySink>(data), 4096, 2);
+        for (std::size_t pos = 0, size = 1; pos < expected.size(); pos += size, size = size * 3 % 10007) {
+            sink.Write(std::span(expected).subspan(pos, std::min(size, expected.size() - pos)));
+        }
+        sink.Close();
+        REQUIRE(data == expected);
+        sink.Write(std::span(expected).first(10));
+    }
+    REQUIRE(data.size() == expected.size() + 10);
+
+    AsyncSink failing(std::make_unique<FailingSink>(), 4096, 2);
+    try {
+        failing.Write(expected);
+        failing.Close();
+        REQUIRE(false);
+    } catch (const OutputError& ex) {
+    }
+
+    // A stream without a buffer fails every write, like a file on a full disk.
+    std::ostream broken(nullptr);
+    try {
+        StreamSink(broken).Write(expected);
+        REQUIRE(false);
+    } catch (const OutputError& ex) {
+    }
+    for (std::size_t chunk_size : {4096, 1 << 20}) {
+        AsyncSink failing_stream(std::make_unique<StreamSink>(broken), chunk_size, 2);
+        try {
+            failing_stream.Write(expected);
+            failing_stream.Close();
+            REQUIRE(false);
+        } catch (const OutputError& ex) {
+        }
+    }
+    try {
+        BitWriter writer(broken);
+        writer.WriteBits(0xABC, 12);
+        writer.Flush();
+        REQUIRE(false);
+    } catch (const OutputError& ex) {
+    }
+    try {
+        // The destructor flushes into the broken stream while the exception unwinds.
+        BitWriter writer(broken);
+        writer.WriteBits(0xABC, 12);
+        throw InvalidFormat();
+    } catch (const InvalidFormat& ex) {
     }
 }
 
 TEST_CASE("BinaryTrie") {
     {
-        BinaryTrie::Pointer a = std::make_shared<BinaryTrie>('a', 1);
-        BinaryTrie::Pointer b = std::make_shared<BinaryTrie>('b', 2);
-        REQUIRE(*a < *b);
-        BinaryTrie::Pointer ab = std::make_shared<BinaryTrie>(a, b);
-        REQUIRE(ab->count_ == 3);
-        REQUIRE(ab->key_ == 'a');
-        BinaryTrie::Pointer c = std::make_shared<BinaryTrie>('c', 2);
-        BinaryTrie::Pointer abc = std::make_shared<BinaryTrie>(ab, c);
-        REQUIRE(abc->count_ == 5);
-        REQUIRE(abc->key_ == 'a');
+        BinaryTrie trie;
+        BinaryTrie::Index a = trie.AddLeaf('a', 1);
+        BinaryTrie::Index b = trie.AddLeaf('b', 2);
+        REQUIRE(trie[a] < trie[b]);
+        BinaryTrie::Index ab = trie.AddNode(a, b);
+        REQUIRE(trie[ab].count == 3);
+        REQUIRE(trie[ab].key == 'a');
+        BinaryTrie::Index c = trie.AddLeaf('c', 2);
+        BinaryTrie::Index abc = trie.AddNode(ab, c);
+        REQUIRE(trie[abc].count == 5);
+        REQUIRE(trie[abc].key == 'a');
         std::vector<char> visited;
         auto callback = [&](std::size_t code, std::size_t height, Char key) { visited.push_back(key); };
-        abc->Traverse(callback);
+        trie.Traverse(abc, callback);
         REQUIRE(visited == std::vector{'a', 'b', 'c'});
     }
     {
-        BinaryTrie::Pointer trie = std::make_shared<BinaryTrie>();
-        trie->AddCode(0b1, 1, 'c');
-        trie->AddCode(0b000, 3, 'a');
-        trie->AddCode(0b001, 3, 'b');
+        BinaryTrie trie;
+        trie.AddCode(0b1, 1, 'c');
+        trie.AddCode(0b000, 3, 'a');
+        trie.AddCode(0b001, 3, 'b');
+        try {
+            trie.AddCode(0b1, 1, 'c');
+            REQUIRE(false);
+        } catch (const BinaryTrie::CodeAlreadyExists& ex) {
+        }
         try {
-            trie->AddCode(0b1, 1, 'c');
+            trie.AddCode(0b00, 2, 'd');
             REQUIRE(false);
         } catch (const BinaryTrie::CodeAlreadyExists& ex) {
         }
         try {
-            trie->AddCode(0b00, 2, 'd');
+            trie.AddCode(0b10, 2, 'd');
             REQUIRE(false);
         } catch (const BinaryTrie::CodeAlreadyExists& ex) {
         }
         std::vector<char> visited;
         auto callback = [&](std::size_t code, std::size_t height, Char key) { visited.push_back(key); };
-        trie->Traverse(callback);
+        trie.Traverse(callback);
         REQUIRE(visited == std::vector{'a', 'b', 'c'});
+        REQUIRE(trie[trie.Child(trie.Child(trie.Root(), false), false)].IsLeaf() == false);
+        REQUIRE(trie[trie.Child(trie.Root(), true)].key == 'c');
+        trie.Clear();
+        trie.AddCode(0b1, 1, 'c');
     }
 }
 
@@ -195,4 +400,781 @@ TEST_CASE("PriorityQueue") {
             queue.Pop();
         }
     }
+    auto check_arity = [](auto queue) {
+        std::mt19937 generator(5);
+        std::vector<int> expected;
+        for (std::size_t i = 0; i < 1000; ++i) {
+            int value = static_cast<int>(generator() % 100);
+            expected.push_back(value);
+            queue.Push(value);
+        }
+        std::sort(expected.begin(), expected.end(), std::greater<>());
+        for (int value : expected) {
+            REQUIRE(queue.PopTop() == value);
+        }
+        REQUIRE(queue.IsEmpty());
+    };
+    check_arity(PriorityQueue<int, std::less<int>, std::vector<int>, 2>());
+    check_arity(PriorityQueue<int, std::less<int>, std::vector<int>, 3>());
+    check_arity(PriorityQueue<int, std::less<int>, std::vector<int>, 8>());
+    {
+        std::vector<int> data(100);
+        std::iota(data.begin(), data.end(), 0);
+        std::shuffle(data.begin(), data.end(), std::mt19937(1));
+        PriorityQueue<int, std::greater<int>> queue(data.begin(), data.end());
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(queue.PopTop() == i);
+        }
+    }
+    {
+        auto compare = [](const std::unique_ptr<int>& lhs, const std::unique_ptr<int>& rhs) { return *lhs < *rhs; };
+        PriorityQueue<std::unique_ptr<int>, decltype(compare)> queue(compare);
+        for (int i : {3, 1, 4, 1, 5}) {
+            queue.Emplace(std::make_unique<int>(i));
+        }
+        REQUIRE(*queue.PopTop() == 5);
+        REQUIRE(*queue.PopTop() == 4);
+        REQUIRE(queue.Size() == 3);
+    }
+}
+
+TEST_CASE("IndexedPriorityQueue") {
+    IndexedPriorityQueue<int> queue(10);
+    for (std::size_t i = 0; i < 10; ++i) {
+        queue.Push(i, static_cast<int>(100 - i));
+    }
+    REQUIRE(queue.Top() == 9);
+    queue.DecreaseKey(3, 0);
+    REQUIRE(queue.Top() == 3);
+    REQUIRE(queue.Key(3) == 0);
+    try {
+        queue.DecreaseKey(5, 1000);
+        REQUIRE(false);
+    } catch (const IndexedPriorityQueue<int>::InvalidIndex& ex) {
+    }
+    queue.ChangeKey(3, 1000);
+    std::vector<std::size_t> order;
+    while (!queue.IsEmpty()) {
+        order.push_back(queue.PopTop());
+    }
+    REQUIRE(order == std::vector<std::size_t>{9, 8, 7, 6, 5, 4, 2, 1, 0, 3});
+    REQUIRE(!queue.Contains(3));
+    queue.Push(3, 1);
+    REQUIRE(queue.Top() == 3);
+}
+
+TEST_CASE("DecodeTable") {
+    auto check = [](const SymbolsCount& symbols_count, std::size_t primary_bits) {
+        CodeTable codes = CanonicalCodes(HuffmanEncoding(symbols_count));
+        std::vector<Char> symbols;
+        for (std::size_t key = 0; key < symbols_count.size(); ++key) {
+            if (symbols_count[key] > 0) {
+                symbols.push_back(static_cast<Char>(key));
+            }
+        }
+        std::stringstream ss;
+        {
+            BitWriter writer(ss);
+            for (std::size_t i = 0; i < 1000; ++i) {
+                const auto& [code, size] = codes[symbols[i % symbols.size()]];
+                writer.WriteBits(code, size);
+            }
+        }
+        DecodeTable table(codes, primary_bits);
+        BitReader reader(ss);
+        for (std::size_t i = 0; i < 1000; ++i) {
+            REQUIRE(table.Decode(reader) == symbols[i % symbols.size()]);
+        }
+    };
+    {
+        SymbolsCount symbols_count{};
+        symbols_count['a'] = 5;
+        symbols_count['b'] = 2;
+        symbols_count['c'] = 1;
+        symbols_count[FILENAME_END] = 1;
+        check(symbols_count, DecodeTable::PRIMARY_BITS);
+        check(symbols_count, 1);
+    }
+    {
+        SymbolsCount symbols_count{};
+        std::size_t previous = 1;
+        std::size_t current = 1;
+        for (Char key = 0; key < 40; ++key) {
+            symbols_count[key] = current;
+            std::size_t next = previous + current;
+            previous = current;
+            current = next;
+        }
+        check(symbols_count, DecodeTable::PRIMARY_BITS);
+        check(symbols_count, 3);
+    }
+    {
+        CodeTable codes{};
+        codes['a'] = {0b0, 1};
+        codes['b'] = {0b1, 1};
+        codes['c'] = {0b10, 1};
+        try {
+            DecodeTable table(codes);
+            REQUIRE(false);
+        } catch (const DecodeTable::InvalidCode& ex) {
+        }
+    }
+    {
+        CodeTable codes{};
+        codes['a'] = {0b0, 1};
+        codes['b'] = {0b10, 2};
+        DecodeTable table(codes);
+        std::stringstream ss;
+        ss.put(static_cast<char>(0b11000000));
+        BitReader reader(ss);
+        try {
+            table.Decode(reader);
+            REQUIRE(false);
+        } catch (const DecodeTable::InvalidCode& ex) {
+        }
+    }
+}
+
+TEST_CASE("HuffmanEncoding") {
+    std::mt19937 generator(7);
+    for (std::size_t test = 0; test < 300; ++test) {
+        SymbolsCount symbols_count{};
+        std::size_t symbols = 1 + generator() % ALPHABET_SIZE;
+        std::size_t max_count = test % 3 == 0 ? 3 : 1000;
+        for (std::size_t i = 0; i < symbols; ++i) {
+            symbols_count[generator() % ALPHABET_SIZE] = 1 + generator() % max_count;
+        }
+        CodeSizes linear = HuffmanEncoding(symbols_count);
+        CodeSizes tree = TreeHuffmanEncoding(symbols_count);
+        REQUIRE(linear.size() == tree.size());
+        for (std::size_t i = 0; i < linear.size(); ++i) {
+            REQUIRE(linear[i].key == tree[i].key);
+            REQUIRE(linear[i].size == tree[i].size);
+        }
+    }
+    REQUIRE(HuffmanEncoding(SymbolsCount{}).empty());
+}
+
+TEST_CASE("LimitedHuffmanEncoding") {
+    SymbolsCount symbols_count{};
+    std::size_t previous = 1;
+    std::size_t current = 1;
+    for (Char key = 0; key < 40; ++key) {
+        symbols_count[key] = current;
+        std::size_t next = previous + current;
+        previous = current;
+        current = next;
+    }
+    for (std::size_t max_size : {6, 8, 15, 64}) {
+        CodeSizes sizes = LimitedHuffmanEncoding(symbols_count, max_size);
+        REQUIRE(sizes.size() == 40);
+        double kraft_sum = 0;
+        for (const auto& [key, size] : sizes) {
+            REQUIRE(size <= max_size);
+            kraft_sum += 1.0 / static_cast<double>(std::size_t{1} << size);
+        }
+        REQUIRE(kraft_sum == 1.0);
+        DecodeTable table(CanonicalCodes(sizes));
+    }
+    REQUIRE(LimitedHuffmanEncoding(symbols_count, 64).back().size == HuffmanEncoding(symbols_count).back().size);
+    SymbolsCount single{};
+    single['a'] = 1;
+    REQUIRE(LimitedHuffmanEncoding(single, 1).front().size == 1);
+}
+
+TEST_CASE("CompactCodeSizes") {
+    std::mt19937 generator(11);
+    std::vector<CodeSizes> cases = {{}, {{'a', 1}}, {{0, 1}, {static_cast<Char>(ALPHABET_SIZE - 1), 1}}};
+    for (std::size_t test = 0; test < 200; ++test) {
+        SymbolsCount symbols_count{};
+        std::size_t symbols = 1 + generator() % ALPHABET_SIZE;
+        for (std::size_t i = 0; i < symbols; ++i) {
+            symbols_count[generator() % ALPHABET_SIZE] = 1 + generator() % (test % 2 == 0 ? 5 : 100000);
+        }
+        cases.push_back(LimitedHuffmanEncoding(symbols_count, MAX_CODE_SIZE));
+    }
+    for (const CodeSizes& sizes : cases) {
+        std::stringstream stream;
+        {
+            BitWriter writer(stream);
+            WriteCompactCodeSizes(writer, sizes);
+        }
+        BitReader reader(stream);
+        CodeSizes read = ReadCompactCodeSizes(reader);
+        REQUIRE(read.size() == sizes.size());
+        for (std::size_t i = 0; i < sizes.size(); ++i) {
+            REQUIRE(read[i].key == sizes[i].key);
+            REQUIRE(read[i].size == sizes[i].size);
+        }
+    }
+
+    std::stringstream stream;
+    {
+        BitWriter writer(stream);
+        writer.WriteBits(2, 9);
+        writer.WriteBits(0b11, 2);
+        writer.WriteBits(MAX_CODE_SIZE + 1, CODE_LENGTH_BITS);
+    }
+    BitReader reader(stream);
+    try {
+        ReadCompactCodeSizes(reader);
+        REQUIRE(false);
+    } catch (const InvalidFormat& ex) {
+    }
+}
+
+TEST_CASE("CountBytes") {
+    std::vector<std::uint8_t> data(100003);
+    SymbolsCount expected{};
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>((i * i + 7 * i) % 253);
+        ++expected[data[i]];
+    }
+    SymbolsCount symbols_count{};
+    symbols_count[FILENAME_END] = 1;
+    ++expected[FILENAME_END];
+    CountBytes(data, symbols_count);
+    REQUIRE(symbols_count == expected);
+    CountBytes(std::span(data).subspan(3, 5), symbols_count);
+    for (std::size_t i = 3; i < 8; ++i) {
+        ++expected[data[i]];
+    }
+    REQUIRE(symbols_count == expected);
+}
+
+TEST_CASE("EncodeBuffer") {
+    std::vector<std::uint8_t> data(5000);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i % 7 == 0 ? i % 251 : i % 3);
+    }
+    SymbolsCount symbols_count{};
+    CountBytes(data, symbols_count);
+    CodeTable codes = CanonicalCodes(HuffmanEncoding(symbols_count));
+    REQUIRE(sizeof(Code) == sizeof(std::uint64_t));
+    std::stringstream ss;
+    {
+        BitWriter writer(ss);
+        EncodeBuffer(writer, codes, data);
+    }
+    DecodeTable table(codes);
+    BitReader reader(ss);
+    for (std::uint8_t c : data) {
+        REQUIRE(table.Decode(reader) == c);
+    }
+}
+
+TEST_CASE("BlockCodec") {
+    std::vector<std::vector<std::uint8_t>> blocks = {{'a'}, {'a', 'b', 'a', 'c'}, std::vector<std::uint8_t>(1000, 7)};
+    std::vector<std::uint8_t> random(100000);
+    for (std::size_t i = 0; i < random.size(); ++i) {
+        random[i] = static_cast<std::uint8_t>((i * i + 13 * i) % 251);
+    }
+    blocks.push_back(random);
+    for (const auto& block : blocks) {
+        for (std::size_t max_code_size : {0, 9}) {
+            EncodedBlock encoded = EncodeBlock(block, max_code_size);
+            REQUIRE(encoded.raw_size == block.size());
+            std::vector<std::uint8_t> decoded(block.size());
+            DecodeBlock(encoded.payload, decoded);
+            REQUIRE(decoded == block);
+        }
+    }
+    EncodedBlock encoded = EncodeBlock(random);
+    encoded.payload.resize(encoded.payload.size() / 2);
+    std::vector<std::uint8_t> decoded(random.size());
+    try {
+        DecodeBlock(encoded.payload, decoded);
+        REQUIRE(false);
+    } catch (const InvalidFormat& ex) {
+    }
+}
+
+TEST_CASE("SharedTable") {
+    std::vector<std::vector<std::uint8_t>> files = {{}, {'a', 'b', 'c'}, {}, {'c', 'c', 'b'}, {'a'}};
+    HuffmanCodec codec;
+    std::vector<EncodedBlock> blocks = codec.EncodeGroup({files.begin(), files.end()});
+    REQUIRE(blocks.size() == files.size());
+    REQUIRE(!blocks[1].shared_table);
+    REQUIRE(blocks[3].shared_table);
+    REQUIRE(blocks[4].shared_table);
+    REQUIRE(blocks[4].payload.size() < blocks[1].payload.size());
+    std::shared_ptr<const DecodeTable> table = codec.ReadSharedTable(blocks[1].payload);
+    for (std::size_t i = 3; i < files.size(); ++i) {
+        REQUIRE(blocks[i].raw_size == files[i].size());
+        std::vector<std::uint8_t> decoded(files[i].size());
+        codec.DecodeShared(*table, blocks[i].payload, decoded);
+        REQUIRE(decoded == files[i]);
+    }
+    std::vector<std::uint8_t> decoded(files[1].size());
+    codec.Decode(blocks[1].payload, decoded);
+    REQUIRE(decoded == files[1]);
+
+    std::vector<EncodedBlock> independent = RansCodec().EncodeGroup({files.begin(), files.end()});
+    REQUIRE(std::none_of(independent.begin(), independent.end(), [](const auto& block) { return block.shared_table; }));
+    try {
+        RansCodec().ReadSharedTable(independent[1].payload);
+        REQUIRE(false);
+    } catch (const InvalidFormat& ex) {
+    }
+}
+
+TEST_CASE("SplitBlock") {
+    std::mt19937 generator(5);
+    std::geometric_distribution<int> skewed(0.2);
+    std::vector<std::uint8_t> text(1 << 18);
+    std::vector<std::uint8_t> binary(1 << 18);
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        text[i] = static_cast<std::uint8_t>('a' + skewed(generator) % 26);
+        binary[i] = static_cast<std::uint8_t>(generator());
+    }
+    REQUIRE(SplitBlock({}).empty());
+    REQUIRE(SplitBlock(text) == std::vector<std::size_t>{text.size()});
+
+    std::vector<std::uint8_t> mixed = text;
+    mixed.insert(mixed.end(), binary.begin(), binary.end());
+    std::vector<std::size_t> sizes = SplitBlock(mixed);
+    REQUIRE(sizes == std::vector<std::size_t>{text.size(), binary.size()});
+
+    HuffmanCodec codec(0, true);
+    REQUIRE(codec.Split(mixed) == sizes);
+    REQUIRE(HuffmanCodec().Split(mixed) == std::vector<std::size_t>{mixed.size()});
+    std::size_t split_size = 0;
+    for (auto part : {std::span(mixed).first(sizes[0]), std::span(mixed).subspan(sizes[0])}) {
+        split_size += codec.Encode(part).payload.size();
+    }
+    REQUIRE(split_size < codec.Encode(mixed).payload.size());
+}
+
+TEST_CASE("Dictionary") {
+    std::string sample = "name: archiver\nversion: 1\nthreads: 4\ncodec: huffman\n";
+    Path sample_name = std::filesystem::temp_directory_path() / "archiver_dictionary_sample";
+    Path dictionary_name = std::filesystem::temp_directory_path() / "archiver_dictionary_test";
+    std::ofstream(sample_name, std::ios::binary) << sample;
+
+    Dictionary dictionary = TrainDictionary({sample_name});
+    REQUIRE(dictionary.id != 0);
+    REQUIRE(dictionary.sizes.size() == 256);
+    SaveDictionary(dictionary_name, dictionary);
+    Dictionary loaded = LoadDictionary(dictionary_name);
+    REQUIRE(loaded.id == dictionary.id);
+    REQUIRE(std::equal(loaded.sizes.begin(), loaded.sizes.end(), dictionary.sizes.begin(), dictionary.sizes.end(),
+                       [](const CodeSize& lhs, const CodeSize& rhs) {
+                           return lhs.key == rhs.key && lhs.size == rhs.size;
+                       }));
+
+    HuffmanCodec plain;
+    HuffmanCodec codec(0, false, std::make_shared<Dictionary>(loaded));
+    std::vector<std::uint8_t> small(sample.begin(), sample.end());
+    std::vector<std::uint8_t> skewed(10000, 'z');
+    for (const auto& data : {std::vector<std::uint8_t>{}, small, skewed}) {
+        EncodedBlock block = codec.Encode(data);
+        std::vector<std::uint8_t> decoded(data.size());
+        codec.Decode(block.payload, decoded);
+        REQUIRE(decoded == data);
+    }
+    REQUIRE(codec.Encode(small).payload.size() < plain.Encode(small).payload.size());
+    REQUIRE(codec.Encode(skewed).payload.size() <= plain.Encode(skewed).payload.size() + 1);
+
+    std::ofstream(dictionary_name, std::ios::binary | std::ios::trunc) << "ADIC";
+    try {
+        LoadDictionary(dictionary_name);
+        REQUIRE(false);
+    } catch (const InvalidDictionary& ex) {
+    }
+    std::vector<Path> unwritable = {std::filesystem::temp_directory_path() / "archiver_missing_directory" /
+                                    "dictionary"};
+    if (std::filesystem::exists("/dev/full")) {
+        unwritable.push_back("/dev/full");
+    }
+    for (const Path& name : unwritable) {
+        try {
+            SaveDictionary(name, dictionary);
+            REQUIRE(false);
+        } catch (const OutputError& ex) {
+        }
+    }
+    std::filesystem::remove(sample_name);
+    std::filesystem::remove(dictionary_name);
+}
+
+TEST_CASE("RansCodec") {
+    std::vector<std::vector<std::uint8_t>> blocks = {{}, {'a'}, {'a', 'b', 'a', 'c'}, std::vector<std::uint8_t>(1000, 7)};
+    std::mt19937 generator(42);
+    std::geometric_distribution<int> skewed(0.1);
+    std::uniform_int_distribution<int> uniform(0, 255);
+    std::vector<std::uint8_t> random(100000);
+    std::vector<std::uint8_t> geometric(100000);
+    for (std::size_t i = 0; i < random.size(); ++i) {
+        random[i] = static_cast<std::uint8_t>(uniform(generator));
+        geometric[i] = static_cast<std::uint8_t>(std::min(skewed(generator), 255));
+    }
+    blocks.push_back(random);
+    blocks.push_back(geometric);
+    auto codec = CreateCodec(CodecId::Rans);
+    for (const auto& block : blocks) {
+        EncodedBlock encoded = codec->Encode(block);
+        REQUIRE(encoded.raw_size == block.size());
+        std::vector<std::uint8_t> decoded(block.size());
+        codec->Decode(encoded.payload, decoded);
+        REQUIRE(decoded == block);
+    }
+    REQUIRE(codec->Encode(geometric).payload.size() <= CreateCodec(CodecId::Huffman)->Encode(geometric).payload.size());
+    EncodedBlock encoded = codec->Encode(geometric);
+    for (std::size_t size : {encoded.payload.size() / 2, encoded.payload.size() - 1}) {
+        std::vector<std::uint8_t> decoded(geometric.size());
+        try {
+            codec->Decode(std::span(encoded.payload).first(size), decoded);
+            REQUIRE(false);
+        } catch (const InvalidFormat& ex) {
+        }
+    }
+}
+
+TEST_CASE("Lz77") {
+    for (std::size_t value = 0; value < 100000; ++value) {
+        ValueCode code = EncodeValue(value);
+        REQUIRE(ValueExtraBits(code.code) == code.extra_bits);
+        REQUIRE(code.extra < (std::size_t{1} << code.extra_bits));
+        REQUIRE(ValueBase(code.code) + code.extra == value);
+    }
+    REQUIRE(EncodeValue(MAX_MATCH_SIZE - MIN_MATCH_SIZE).code < MATCH_CODES_COUNT);
+    REQUIRE(EncodeValue((std::size_t{1} << MAX_WINDOW_BITS) - 1).code < DISTANCE_CODES_COUNT);
+
+    std::mt19937 generator(3);
+    std::vector<std::string> words = {"error", "warning", "request", "timeout", "{\"id\": ", "\n"};
+    std::vector<std::uint8_t> text;
+    while (text.size() < 200000) {
+        const std::string& word = words[generator() % words.size()];
+        text.insert(text.end(), word.begin(), word.end());
+        text.push_back(static_cast<std::uint8_t>('0' + generator() % 10));
+    }
+    std::vector<std::vector<std::uint8_t>> blocks = {{}, {'a'}, {'a', 'b', 'a', 'b', 'a', 'b', 'a'},
+                                                     std::vector<std::uint8_t>(1000, 7), text};
+    for (const auto& block : blocks) {
+        for (std::size_t level : {MIN_LEVEL, DEFAULT_LEVEL, MAX_LEVEL}) {
+            for (std::size_t window_bits : {MIN_WINDOW_BITS, DEFAULT_WINDOW_BITS}) {
+                Lz77Options options{level, window_bits};
+                std::vector<std::uint8_t> restored;
+                for (const Lz77Token& token : FindMatches(block, options)) {
+                    if (token.size == 0) {
+                        restored.push_back(token.literal);
+                        continue;
+                    }
+                    REQUIRE(token.size >= MIN_MATCH_SIZE);
+                    REQUIRE(token.size <= MAX_MATCH_SIZE);
+                    REQUIRE(token.distance >= 1);
+                    REQUIRE(token.distance < (std::size_t{1} << window_bits));
+                    REQUIRE(token.distance <= restored.size());
+                    for (std::size_t i = 0; i < token.size; ++i) {
+                        restored.push_back(restored[restored.size() - token.distance]);
+                    }
+                }
+                REQUIRE(restored == block);
+
+                EncodedBlock encoded = EncodeLz77Block(block, options);
+                std::vector<std::uint8_t> decoded(block.size());
+                DecodeLz77Block(encoded.payload, decoded);
+                REQUIRE(decoded == block);
+            }
+        }
+    }
+
+    auto codec = CreateCodec(CodecId::Lz77);
+    EncodedBlock encoded = codec->Encode(text);
+    REQUIRE(encoded.payload.size() < EncodeBlock(text).payload.size() / 2);
+    for (std::size_t size : {encoded.payload.size() / 2, encoded.payload.size() - 1}) {
+        std::vector<std::uint8_t> decoded(text.size());
+        try {
+            codec->Decode(std::span(encoded.payload).first(size), decoded);
+            REQUIRE(false);
+        } catch (const InvalidFormat& ex) {
+        }
+    }
+}
+
+TEST_CASE("ThreadPool") {
+    ThreadPool pool(4);
+    REQUIRE(pool.Size() == 4);
+    std::vector<std::future<std::size_t>> results;
+    for (std::size_t i = 0; i < 100; ++i) {
+        results.push_back(pool.Submit([i] { return i * i; }));
+    }
+    for (std::size_t i = 0; i < 100; ++i) {
+        REQUIRE(results[i].get() == i * i);
+    }
+    auto failed = pool.Submit([]() -> int { throw InvalidFormat(); });
+    try {
+        failed.get();
+        REQUIRE(false);
+    } catch (const InvalidFormat& ex) {
+    }
+    std::vector<std::future<std::future<std::size_t>>> nested;
+    for (std::size_t i = 0; i < 100; ++i) {
+        nested.push_back(pool.Submit([&pool, i] { return pool.Submit([i] { return i + 1; }); }));
+    }
+    for (std::size_t i = 0; i < 100; ++i) {
+        REQUIRE(nested[i].get().get() == i + 1);
+    }
+
+    // Tasks queued behind a task that blocks its worker are stolen by the other workers.
+    const auto timeout = std::chrono::seconds(10);
+    std::promise<void> release;
+    auto blocker = pool.Submit([released = release.get_future().share()] { released.wait(); });
+    std::vector<std::future<std::size_t>> queued;
+    for (std::size_t i = 0; i < 4 * pool.Size(); ++i) {
+        queued.push_back(pool.Submit([i] { return i; }));
+    }
+    for (std::size_t i = 0; i < queued.size(); ++i) {
+        REQUIRE(queued[i].wait_for(timeout) == std::future_status::ready);
+        REQUIRE(queued[i].get() == i);
+    }
+    release.set_value();
+    blocker.get();
+
+    // Subtasks submitted by a worker spread over the idle workers, so all of them run at once.
+    const std::size_t subtasks_count = pool.Size() - 1;
+    std::atomic<std::size_t> started = 0;
+    auto outer = pool.Submit([&pool, &started, subtasks_count, timeout] {
+        std::vector<std::future<bool>> subtasks;
+        for (std::size_t i = 0; i < subtasks_count; ++i) {
+            subtasks.push_back(pool.Submit([&started, subtasks_count, timeout] {
+                ++started;
+                auto deadline = std::chrono::steady_clock::now() + timeout;
+                while (started < subtasks_count && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::yield();
+                }
+                return started >= subtasks_count;
+            }));
+        }
+        return subtasks;
+    });
+    for (auto& subtask : outer.get()) {
+        REQUIRE(subtask.get());
+    }
+}
+
+TEST_CASE("InputFiles") {
+    Path root = std::filesystem::temp_directory_path() / "archiver_input_files_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "b" / "c");
+    std::filesystem::create_directories(root / "empty");
+    for (const char* name : {"b/c/d", "b/a", "z", "a"}) {
+        std::ofstream(root / name) << name;
+    }
+    std::vector<InputFile> inputs = CollectInputs({root / "z", STANDARD_STREAM, root / ""});
+    std::vector<std::string> names;
+    for (const InputFile& input : inputs) {
+        names.push_back(input.name);
+    }
+    std::string base = root.filename().string();
+    REQUIRE(names == std::vector<std::string>{"z", "-", base + "/a", base + "/b/a", base + "/b/c/d", base + "/z"});
+    REQUIRE(inputs[3].path == root / "b" / "a");
+    inputs = CollectInputs({root / "b"}, root / "b" / "c" / ".." / "a");
+    REQUIRE(inputs.size() == 1);
+    REQUIRE(inputs[0].name == "b/c/d");
+    std::filesystem::remove_all(root);
+
+    for (const char* name : {"../a", "a/../../b", "/a", ""}) {
+        try {
+            PrepareOutput(name);
+            REQUIRE(false);
+        } catch (const UnsafePath& ex) {
+        }
+    }
+}
+
+TEST_CASE("Checksum") {
+    std::string_view check = "123456789";
+    std::span<const std::uint8_t> data(reinterpret_cast<const std::uint8_t*>(check.data()), check.size());
+    REQUIRE(Crc32c({}) == 0);
+    REQUIRE(Crc32c(data) == 0xE3069283);
+    REQUIRE(Crc32c(data.subspan(4), Crc32c(data.first(4))) == 0xE3069283);
+    for (std::size_t split = 0; split <= data.size(); ++split) {
+        std::uint32_t first = Crc32c(data.first(split));
+        std::uint32_t second = Crc32c(data.subspan(split));
+        REQUIRE(Crc32cCombine(first, second, data.size() - split) == 0xE3069283);
+    }
+
+    std::mt19937 generator(42);
+    std::vector<std::uint8_t> random(100000);
+    for (auto& byte : random) {
+        byte = generator();
+    }
+    for (std::size_t size : {1, 7, 8, 9, 24575, 24576, 24577, 49152, 100000}) {
+        for (std::size_t offset : {0, 1, 3}) {
+            if (offset + size > random.size()) {
+                continue;
+            }
+            std::span<const std::uint8_t> part(random.data() + offset, size);
+            std::uint32_t expected = ~0u;
+            for (std::uint8_t byte : part) {
+                expected ^= byte;
+                for (int bit = 0; bit < 8; ++bit) {
+                    expected = (expected >> 1) ^ (0x82F63B78 & (0 - (expected & 1)));
+                }
+            }
+            REQUIRE(Crc32c(part) == ~expected);
+            REQUIRE(Crc32c(part.subspan(size / 3), Crc32c(part.first(size / 3))) == ~expected);
+        }
+    }
+
+    auto hex = [](const Sha256Digest& digest) {
+        std::ostringstream os;
+        for (std::uint8_t byte : digest) {
+            os << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+        }
+        return os.str();
+    };
+    auto bytes = [](std::string_view text) {
+        return std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(text.data()), text.size());
+    };
+    REQUIRE(hex(Sha256({})) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    REQUIRE(hex(Sha256(bytes("abc"))) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    REQUIRE(hex(Sha256(bytes("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"))) ==
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    std::string million(1000000, 'a');
+    REQUIRE(hex(Sha256(bytes(million))) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_CASE("Dedup") {
+    std::mt19937 generator(7);
+    std::vector<std::uint8_t> data(1 << 20);
+    for (auto& byte : data) {
+        byte = generator();
+    }
+    std::vector<std::size_t> sizes = FindChunks(data);
+    REQUIRE(std::accumulate(sizes.begin(), sizes.end(), std::size_t{0}) == data.size());
+    REQUIRE(sizes.size() > 1);
+    for (std::size_t i = 0; i + 1 < sizes.size(); ++i) {
+        REQUIRE(sizes[i] >= MIN_CHUNK_SIZE);
+        REQUIRE(sizes[i] <= MAX_CHUNK_SIZE);
+    }
+    REQUIRE(FindChunks(std::span(data).first(100)) == std::vector<std::size_t>{100});
+    REQUIRE(FindChunks({}).empty());
+    for (std::size_t size : FindChunks(data, 1 << 14)) {
+        REQUIRE(size <= 1 << 14);
+    }
+
+    std::vector<std::uint8_t> inserted(data.begin(), data.begin() + 1000);
+    inserted.insert(inserted.end(), 10, 0);
+    inserted.insert(inserted.end(), data.begin() + 1000, data.end());
+    std::vector<std::size_t> shifted = FindChunks(inserted);
+    REQUIRE(shifted.size() == sizes.size());
+    REQUIRE(shifted.front() == sizes.front() + 10);
+    REQUIRE(std::equal(sizes.begin() + 1, sizes.end(), shifted.begin() + 1));
+
+    std::span<const std::uint8_t> chunk = std::span(data).first(sizes.front());
+    std::vector<std::uint8_t> copy(chunk.begin(), chunk.end());
+    REQUIRE(MakeChunkKey(chunk) == MakeChunkKey(copy));
+    copy.back() ^= 1;
+    REQUIRE(!(MakeChunkKey(chunk) == MakeChunkKey(copy)));
+
+    ChunkIndex index;
+    REQUIRE(!index.Contains(MakeChunkKey(chunk)));
+    REQUIRE(index.Find(MakeChunkKey(chunk)) == nullptr);
+    index.Insert(MakeChunkKey(chunk), {{20, 7, 10, 0}});
+    REQUIRE(index.Contains(MakeChunkKey(chunk)));
+    REQUIRE(index.Find(MakeChunkKey(chunk))->front().payload_offset == 20);
+    REQUIRE(!index.Contains(MakeChunkKey(copy)));
+}
+
+TEST_CASE("ArchiveDirectory") {
+    ArchiveDirectory directory = {{"first", 5, 45, 30, 0xDEADBEEF, {{20, 7, 10, 0}, {35, 9, 20, 10, true}}},
+                                  {"second", 50, 10, 0, 0, {}}};
+    Path filename = std::filesystem::temp_directory_path() / "archiver_directory_test";
+    {
+        std::ofstream os(filename, std::ios::binary);
+        BitWriter writer(os);
+        WriteArchiveHeader(writer);
+        writer.WriteBytes(std::vector<std::uint8_t>(95));
+        WriteArchiveDirectory(writer, directory);
+    }
+    {
+        auto archive = RandomAccessFile::Open(filename);
+        ArchiveDirectory read = ReadArchiveDirectory(archive);
+        REQUIRE(read.size() == 2);
+        REQUIRE(read[0].name == "first");
+        REQUIRE(read[0].header_offset == 5);
+        REQUIRE(read[0].compressed_size == 45);
+        REQUIRE(read[0].size == 30);
+        REQUIRE(read[0].checksum == 0xDEADBEEF);
+        REQUIRE(read[0].blocks.size() == 2);
+        REQUIRE(read[0].blocks[1].payload_offset == 35);
+        REQUIRE(read[0].blocks[1].payload_size == 9);
+        REQUIRE(read[0].blocks[1].raw_size == 20);
+        REQUIRE(read[0].blocks[1].output_offset == 10);
+        REQUIRE(!read[0].blocks[0].shared_table);
+        REQUIRE(read[0].blocks[1].shared_table);
+        REQUIRE(read[1].name == "second");
+        REQUIRE(read[1].blocks.empty());
+    }
+    std::uint64_t archive_size = std::filesystem::file_size(filename);
+    {
+        std::ofstream os(filename, std::ios::binary | std::ios::app);
+        BitWriter writer(os);
+        writer.WriteBytes(std::vector<std::uint8_t>(1 << 17, 'A'));
+        writer.WriteBytes(DIRECTORY_MAGIC);
+        writer.Flush();
+    }
+    {
+        auto archive = RandomAccessFile::Open(filename);
+        REQUIRE(FindArchiveEnd(archive) == archive_size);
+        REQUIRE(ReadArchiveDirectory(archive).size() == 2);
+    }
+    std::filesystem::resize_file(filename, archive_size - 1);
+    {
+        auto archive = RandomAccessFile::Open(filename);
+        try {
+            ReadArchiveDirectory(archive);
+            REQUIRE(false);
+        } catch (const InvalidFormat& ex) {
+        }
+    }
+    std::filesystem::remove(filename);
+}
+
+TEST_CASE("Stats") {
+    Stats stats;
+    {
+        StageTimer timer(nullptr, Stage::Decode);
+    }
+    for (int i = 0; i < 3; ++i) {
+        StageTimer timer(&stats, Stage::Decode);
+    }
+    REQUIRE(stats.stages[static_cast<std::size_t>(Stage::Decode)].calls == (STATS_ENABLED ? 3 : 0));
+    REQUIRE(stats.stages[static_cast<std::size_t>(Stage::Open)].calls == 0);
+    {
+        StageTimer timer(&stats, Stage::Open);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    const StageTime& open = stats.stages[static_cast<std::size_t>(Stage::Open)];
+    REQUIRE(open.wall >= (STATS_ENABLED ? std::chrono::milliseconds(20) : std::chrono::milliseconds(0)));
+    REQUIRE(open.cpu <= open.wall);
+    Stats merged;
+    MergeStats(merged, stats);
+    MergeStats(merged, stats);
+    REQUIRE(merged.stages[static_cast<std::size_t>(Stage::Decode)].calls == (STATS_ENABLED ? 6 : 0));
+    REQUIRE(merged.stages[static_cast<std::size_t>(Stage::Open)].wall == 2 * open.wall);
+    stats.stages[static_cast<std::size_t>(Stage::Open)] = {};
+
+    stats.files = 2;
+    stats.bytes_in = 100;
+    stats.bytes_out = 60;
+    stats.symbols = 104;
+    stats.code_bits = 416;
+    stats.stages[static_cast<std::size_t>(Stage::Decode)].calls = 3;
+    stats.stages[static_cast<std::size_t>(Stage::Decode)].wall = std::chrono::milliseconds(1500);
+    stats.stages[static_cast<std::size_t>(Stage::Decode)].cpu = std::chrono::milliseconds(250);
+    std::ostringstream json;
+    PrintStats(json, stats, StatsFormat::Json);
+    REQUIRE(json.str() ==
+            "{\"files\": 2, \"bytes_in\": 100, \"bytes_out\": 60, \"symbols\": 104, "
+            "\"average_code_length\": 4.000000, \"stages\": {\"decode\": {\"calls\": 3, \"wall_seconds\": 1.500000, "
+            "\"cpu_seconds\": 0.250000}}}\n");
+    std::ostringstream text;
+    PrintStats(text, stats);
+    REQUIRE(text.str().find("average code length        4.000 bits\n") != std::string::npos);
+    REQUIRE(text.str().find("open") == std::string::npos);
+    text << 0.5;
+    REQUIRE(text.str().ends_with("0.5"));
 }
@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t threads_count) {
+    threads_count = std::max<std::size_t>(threads_count, 1);
+    queues_.reserve(threads_count);
+    for (std::size_t i = 0; i < threads_count; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(threads_count);
+    for (std::size_t i = 0; i < threads_count; ++i) {
+        threads_.emplace_back(&ThreadPool::Work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(idle_mutex_);
+        stopped_ = true;
+    }
+    idle_condition_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::size_t ThreadPool::Size() const {
+    return threads_.size();
+}
+
+// Wakes a sleeping worker for every task, whichever queue it went to, so it can steal the task while the owner of
+// that queue is busy.
+void ThreadPool::Push(std::function<void()> task) {
+    std::size_t index = current_pool == this ? current_index : next_queue_++ % queues_.size();
+    {
+        std::lock_guard lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    if (sleeping_ == 0) {
+        return;
+    }
+    {
+        std::lock_guard lock(idle_mutex_);
+        wakeups_ = std::min(wakeups_ + 1, sleeping_.load());
+    }
+    idle_condition_.notify_one();
+}
+
+// Takes the oldest task of the own queue or the newest task of another one.
+std::function<void()> ThreadPool::Take(std::size_t index) {
+    for (std::size_t i = 0; i < queues_.size(); ++i) {
+        Queue& queue = *queues_[(index + i) % queues_.size()];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        std::function<void()> task;
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        return task;
+    }
+    return {};
+}
+
+// A worker counts itself as sleeping before it looks at the queues a last time, so a task pushed after that look sees
+// the count and wakes it. It leaves once the pool is stopped and every queue is empty.
+void ThreadPool::Work(std::size_t index) {
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        std::function<void()> task = Take(index);
+        if (!task) {
+            std::unique_lock lock(idle_mutex_);
+            ++sleeping_;
+            task = Take(index);
+            if (!task) {
+                if (stopped_) {
+                    --sleeping_;
+                    return;
+                }
+                idle_condition_.wait(lock, [this] { return stopped_ || wakeups_ > 0; });
+                if (wakeups_ > 0) {
+                    --wakeups_;
+                }
+            }
+            --sleeping_;
+        }
+        if (task) {
+            task();
+        }
+    }
+}
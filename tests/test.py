@@ -1,11 +1,43 @@
 import filecmp
+import json
 import os
+import resource
 import shutil
 import sys
 import subprocess
 import tempfile
 
 
+ROUNDTRIP_OPTIONS = [
+    (["-j", "1"], []),
+    (["-j", "4", "--block-size", "65536"], []),
+    (["-j", "4", "--block-size", "65536"], ["-j", "4"]),
+    (["--codec", "rans"], []),
+    (["--codec", "rans", "-j", "4", "--block-size", "65536"], ["-j", "4"]),
+    (["--codec", "lz77"], []),
+    (["--adaptive", "-j", "4"], ["-j", "4"]),
+    (["--solid"], []),
+    (["--solid", "-j", "4", "--block-size", "1024"], ["-j", "4"]),
+    (["--level", "9", "--window", "12", "-j", "4", "--block-size", "65536"], ["-j", "4"]),
+    (["--dedup", "-j", "4", "--block-size", "65536"], ["-j", "4"]),
+]
+
+DIRECTORY_OPTIONS = [
+    [],
+    ["-j", "4"],
+    ["--solid", "-j", "4", "--block-size", "1024"],
+    ["--dedup", "--solid", "-j", "4"],
+]
+
+ARCHIVE_VERSION = 7
+ERROR_EXIT_CODE = 111
+MEMORY_LIMIT = 1 << 30
+FULL_DEVICE = "/dev/full"
+
+# A reference to a repeated chunk is larger than the coded chunk for tiny files.
+MIN_DEDUP_SIZE = 1024
+
+
 def are_dir_trees_equal(dir1, dir2):
     dirs_cmp = filecmp.dircmp(dir1, dir2)
     if len(dirs_cmp.left_only)>0 or len(dirs_cmp.right_only)>0 or \
@@ -52,6 +84,52 @@ class ArchiverTester:
                     tester.test_compression_decompression(name)
                 except ArchiverTester.TestCaseFailedException:
                     all_ok = False
+                try:
+                    tester.test_streaming(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_list_extract(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_dictionary(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_append(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_corruption(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_dedup(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_stats(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                try:
+                    tester.test_write_errors(name)
+                except ArchiverTester.TestCaseFailedException:
+                    all_ok = False
+                for compress_options in DIRECTORY_OPTIONS:
+                    try:
+                        tester.test_directory(name, compress_options)
+                    except ArchiverTester.TestCaseFailedException:
+                        all_ok = False
+                    try:
+                        tester.test_archive_in_directory(name, compress_options)
+                    except ArchiverTester.TestCaseFailedException:
+                        all_ok = False
+                for compress_options, decompress_options in ROUNDTRIP_OPTIONS:
+                    try:
+                        tester.test_roundtrip(name, compress_options, decompress_options)
+                    except ArchiverTester.TestCaseFailedException:
+                        all_ok = False
         return all_ok
 
     def test_compression_decompression(self, name):
@@ -63,7 +141,8 @@ class ArchiverTester:
             with tempfile.NamedTemporaryFile() as output_file:
                 subprocess.check_call([self.archiver_executable, "-c", output_file.name] + input_files, cwd=test_case_data_dir)
 
-                if not filecmp.cmp(test_case_archive, output_file.name, shallow=False):
+                if os.path.exists(test_case_archive) and \
+                        not filecmp.cmp(test_case_archive, output_file.name, shallow=False):
                     self.fail_test_case(name, "compressed file differs from expected")
 
                 with tempfile.TemporaryDirectory() as output_dir:
@@ -76,6 +155,344 @@ class ArchiverTester:
         except subprocess.CalledProcessError:
             self.fail_test_case(name, "archiver finished with non-zero exit code")
 
+    def test_roundtrip(self, name, compress_options, decompress_options):
+        case_name = " ".join([name, "-c"] + compress_options + ["-d"] + decompress_options)
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+
+            with tempfile.NamedTemporaryFile() as output_file:
+                subprocess.check_call([self.archiver_executable] + compress_options + ["-c", output_file.name] +
+                                      input_files, cwd=test_case_data_dir)
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    subprocess.check_call([self.archiver_executable] + decompress_options + ["-d", output_file.name],
+                                          cwd=output_dir)
+
+                    if not are_dir_trees_equal(test_case_data_dir, output_dir):
+                        self.fail_test_case(case_name, "decompressed files differ from expected")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_list_extract(self, name):
+        case_name = name + " -l -x"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+
+            with tempfile.NamedTemporaryFile() as output_file:
+                subprocess.check_call([self.archiver_executable, "-j", "2", "-c", output_file.name] + input_files,
+                                      cwd=test_case_data_dir)
+
+                listing = subprocess.check_output([self.archiver_executable, "-l", output_file.name], text=True)
+                listed_files = [line.split(maxsplit=3)[3] for line in listing.splitlines()]
+                if listed_files != input_files:
+                    self.fail_test_case(case_name, "listed files differ from expected")
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    subprocess.check_call([self.archiver_executable, "-x", output_file.name, input_files[-1]],
+                                          cwd=output_dir)
+
+                    if os.listdir(output_dir) != [input_files[-1]] or not filecmp.cmp(
+                            os.path.join(test_case_data_dir, input_files[-1]),
+                            os.path.join(output_dir, input_files[-1]), shallow=False):
+                        self.fail_test_case(case_name, "extracted file differs from expected")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_dictionary(self, name):
+        case_name = name + " --train --dict"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+
+            with tempfile.NamedTemporaryFile() as dictionary_file, tempfile.NamedTemporaryFile() as output_file:
+                subprocess.check_call([self.archiver_executable, "--train", dictionary_file.name] + input_files,
+                                      cwd=test_case_data_dir)
+                subprocess.check_call([self.archiver_executable, "--dict", dictionary_file.name, "-c",
+                                       output_file.name] + input_files, cwd=test_case_data_dir)
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    if subprocess.call([self.archiver_executable, "-d", output_file.name], cwd=output_dir,
+                                       stderr=subprocess.DEVNULL) == 0:
+                        self.fail_test_case(case_name, "archive decompressed without dictionary")
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    subprocess.check_call([self.archiver_executable, "--dict", dictionary_file.name, "-d",
+                                           output_file.name], cwd=output_dir)
+
+                    if not are_dir_trees_equal(test_case_data_dir, output_dir):
+                        self.fail_test_case(case_name, "decompressed files differ from expected")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_directory(self, name, compress_options):
+        case_name = " ".join([name, "-c"] + compress_options + ["DIRECTORY"])
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+
+            with tempfile.NamedTemporaryFile() as output_file:
+                subprocess.check_call([self.archiver_executable] + compress_options + ["-c", output_file.name, name],
+                                      cwd=self.test_data_dir)
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    subprocess.check_call([self.archiver_executable, "-d", output_file.name], cwd=output_dir)
+
+                    if os.listdir(output_dir) != [name] or \
+                            not are_dir_trees_equal(test_case_data_dir, os.path.join(output_dir, name)):
+                        self.fail_test_case(case_name, "decompressed files differ from expected")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_archive_in_directory(self, name, compress_options):
+        case_name = " ".join([name, "-c"] + compress_options + ["DIRECTORY/ARCHIVE DIRECTORY"])
+        try:
+            with tempfile.TemporaryDirectory() as input_dir:
+                shutil.copytree(self.get_test_case_data_dir(name), os.path.join(input_dir, name))
+                archive = os.path.join(name, "archive.arc")
+                for _ in range(2):
+                    subprocess.check_call([self.archiver_executable] + compress_options + ["-c", archive, name],
+                                          cwd=input_dir)
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    subprocess.check_call([self.archiver_executable, "-d", os.path.join(input_dir, archive)],
+                                          cwd=output_dir)
+
+                    if not are_dir_trees_equal(self.get_test_case_data_dir(name), os.path.join(output_dir, name)):
+                        self.fail_test_case(case_name, "the archive was archived into itself")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_append(self, name):
+        case_name = name + " -a"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+            middle = len(input_files) // 2
+
+            with tempfile.TemporaryDirectory() as archive_dir:
+                archive = os.path.join(archive_dir, "archive.arc")
+                previous = b""
+                for files in [input_files[:middle], input_files[middle:]]:
+                    if files:
+                        subprocess.check_call([self.archiver_executable, "--solid", "-j", "2", "-a", archive] + files,
+                                              cwd=test_case_data_dir)
+                        with open(archive, "rb") as f:
+                            data = f.read()
+                        if not data.startswith(previous):
+                            self.fail_test_case(case_name, "append changed the existing archive")
+                        previous = data
+                subprocess.check_call([self.archiver_executable, "-t", archive])
+
+                if middle > 0:
+                    # Cutting the archive where an append started must give back the archive before it.
+                    prefix = os.path.join(archive_dir, "prefix.arc")
+                    shutil.copy(archive, prefix)
+                    subprocess.check_call([self.archiver_executable, "-a", prefix] + input_files[:middle],
+                                          cwd=test_case_data_dir)
+                    os.truncate(prefix, len(previous))
+                    subprocess.check_call([self.archiver_executable, "-t", prefix])
+
+                # A member added again under the same name replaces the earlier one on extraction.
+                with tempfile.TemporaryDirectory() as input_dir:
+                    updated = os.path.join(archive_dir, "updated.arc")
+                    member = os.path.join(input_dir, "member")
+                    expected = None
+                    for file in input_files:
+                        shutil.copy(os.path.join(test_case_data_dir, file), member)
+                        with open(member, "rb") as f:
+                            expected = f.read()
+                        subprocess.check_call([self.archiver_executable, "-a", updated, "member"], cwd=input_dir)
+                    if expected is not None:
+                        for command in [["-x", updated, "member"], ["-d", updated], ["-j", "2", "-d", updated]]:
+                            with tempfile.TemporaryDirectory() as output_dir:
+                                subprocess.check_call([self.archiver_executable] + command, cwd=output_dir)
+                                with open(os.path.join(output_dir, "member"), "rb") as f:
+                                    if f.read() != expected:
+                                        self.fail_test_case(case_name, "an earlier copy of a member was extracted")
+
+                listing = subprocess.check_output([self.archiver_executable, "-l", archive], text=True)
+                if [line.split(maxsplit=3)[3] for line in listing.splitlines()] != input_files:
+                    self.fail_test_case(case_name, "listed files differ from expected")
+
+                with tempfile.TemporaryDirectory() as output_dir:
+                    subprocess.check_call([self.archiver_executable, "-d", archive], cwd=output_dir)
+
+                    if not are_dir_trees_equal(test_case_data_dir, output_dir):
+                        self.fail_test_case(case_name, "decompressed files differ from expected")
+
+                legacy = os.path.join(archive_dir, "legacy.arc")
+                subprocess.check_call([self.archiver_executable, "-c", legacy] + input_files, cwd=test_case_data_dir)
+                if subprocess.call([self.archiver_executable, "-a", legacy] + input_files, cwd=test_case_data_dir,
+                                   stderr=subprocess.DEVNULL) == 0:
+                    self.fail_test_case(case_name, "appended to an archive without directory")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_corruption(self, name):
+        case_name = name + " -t"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+
+            with tempfile.NamedTemporaryFile() as output_file:
+                subprocess.check_call([self.archiver_executable, "-j", "2", "-c", output_file.name] + input_files,
+                                      cwd=test_case_data_dir)
+                for options in [[], ["-j", "4"]]:
+                    subprocess.check_call([self.archiver_executable] + options + ["-t", output_file.name])
+
+                data = bytearray(output_file.read())
+                data[len(data) // 2] ^= 0x10
+                output_file.seek(0)
+                output_file.write(data)
+                output_file.flush()
+                for options in [[], ["-j", "4"]]:
+                    if subprocess.call([self.archiver_executable] + options + ["-t", output_file.name],
+                                       stderr=subprocess.DEVNULL) == 0:
+                        self.fail_test_case(case_name, "corrupted archive passed the test")
+
+            # A block claiming a 1 GiB input and a 4 GiB payload must be rejected before anything is allocated.
+            with tempfile.NamedTemporaryFile() as output_file:
+                name = b"a"
+                output_file.write(b"\0ARC" + bytes([ARCHIVE_VERSION, 0, 0, 0, 0, 0]) + len(name).to_bytes(2, "big") +
+                                  name + (1 << 30).to_bytes(4, "big") + (0xFFFFFFF0).to_bytes(4, "big") + bytes(4))
+                output_file.flush()
+                limit_memory = lambda: resource.setrlimit(resource.RLIMIT_AS, (MEMORY_LIMIT, MEMORY_LIMIT))
+                if subprocess.call([self.archiver_executable, "-t", output_file.name], stderr=subprocess.DEVNULL,
+                                   preexec_fn=limit_memory) != ERROR_EXIT_CODE:
+                    self.fail_test_case(case_name, "oversized block was not rejected")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_dedup(self, name):
+        case_name = name + " --dedup"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+
+            with tempfile.TemporaryDirectory() as input_dir:
+                copies = ["first", "second"]
+                for copy in copies:
+                    shutil.copytree(test_case_data_dir, os.path.join(input_dir, copy))
+
+                sizes = []
+                with tempfile.TemporaryDirectory() as archive_dir:
+                    for options in [["-j", "2"], ["-j", "2", "--dedup"]]:
+                        archive = os.path.join(archive_dir, "archive.arc")
+                        subprocess.check_call([self.archiver_executable] + options + ["-c", archive] + copies,
+                                              cwd=input_dir)
+                        sizes.append(os.path.getsize(archive))
+                    subprocess.check_call([self.archiver_executable, "-j", "4", "-t", archive])
+
+                    with tempfile.TemporaryDirectory() as output_dir:
+                        subprocess.check_call([self.archiver_executable, "-d", archive], cwd=output_dir)
+
+                        if not are_dir_trees_equal(input_dir, output_dir):
+                            self.fail_test_case(case_name, "decompressed files differ from expected")
+
+                data_size = sum(os.path.getsize(os.path.join(test_case_data_dir, filename))
+                                for filename in os.listdir(test_case_data_dir))
+                if data_size >= MIN_DEDUP_SIZE and sizes[1] >= sizes[0]:
+                    self.fail_test_case(case_name, "repeated files were not deduplicated")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_stats(self, name):
+        case_name = name + " --stats"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+            data_size = sum(os.path.getsize(os.path.join(test_case_data_dir, filename)) for filename in input_files)
+
+            with tempfile.NamedTemporaryFile() as output_file:
+                for compress_options, stages in [([], ["count_symbols", "write_file"]),
+                                                 (["-j", "2"], ["open", "encode", "write_file"])]:
+                    stats = json.loads(subprocess.run(
+                        [self.archiver_executable, "--stats", "json"] + compress_options + ["-c", output_file.name] +
+                        input_files, cwd=test_case_data_dir, stderr=subprocess.PIPE, check=True).stderr)
+                    if stats["files"] != len(input_files) or stats["bytes_in"] != data_size or \
+                            any(stage not in stats["stages"] for stage in ["total"] + stages):
+                        self.fail_test_case(case_name, "compression stats differ from expected")
+
+                    for options in [[], ["-j", "2"]]:
+                        stats = json.loads(subprocess.run(
+                            [self.archiver_executable, "--stats", "json"] + options + ["-t", output_file.name],
+                            stderr=subprocess.PIPE, check=True).stderr)
+                        if stats["files"] != len(input_files) or stats["bytes_out"] != data_size:
+                            self.fail_test_case(case_name, "decompression stats differ from expected")
+
+                subprocess.run([self.archiver_executable, "--stats", "text", "-t", output_file.name],
+                               stderr=subprocess.DEVNULL, check=True)
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_write_errors(self, name):
+        case_name = name + " FULL DISK"
+        if not os.path.exists(FULL_DEVICE):
+            return
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            input_files = sorted(os.listdir(test_case_data_dir))
+
+            for options in [[], ["-j", "2"]]:
+                if subprocess.call([self.archiver_executable] + options + ["-c", FULL_DEVICE] + input_files,
+                                   cwd=test_case_data_dir, stderr=subprocess.DEVNULL) != ERROR_EXIT_CODE:
+                    self.fail_test_case(case_name, "writing to a full disk did not fail")
+
+                with tempfile.NamedTemporaryFile() as output_file:
+                    subprocess.check_call([self.archiver_executable] + options + ["-c", output_file.name] +
+                                          input_files, cwd=test_case_data_dir)
+                    data_size = sum(os.path.getsize(os.path.join(test_case_data_dir, filename))
+                                    for filename in input_files)
+                    with open(FULL_DEVICE, "wb") as full:
+                        code = subprocess.call([self.archiver_executable, "--stdout", "-d", output_file.name],
+                                               stdout=full, stderr=subprocess.DEVNULL)
+                    if data_size > 0 and code != ERROR_EXIT_CODE:
+                        self.fail_test_case(case_name, "decompressing to a full disk did not fail")
+
+            if input_files and subprocess.call([self.archiver_executable, "--train", FULL_DEVICE] + input_files,
+                                               cwd=test_case_data_dir, stderr=subprocess.DEVNULL) != ERROR_EXIT_CODE:
+                self.fail_test_case(case_name, "saving a dictionary to a full disk did not fail")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
+    def test_streaming(self, name):
+        case_name = name + " -c - --stdout -d"
+        try:
+            test_case_data_dir = self.get_test_case_data_dir(name)
+            data = b"".join(open(os.path.join(test_case_data_dir, filename), "rb").read()
+                            for filename in sorted(os.listdir(test_case_data_dir)))
+
+            with tempfile.NamedTemporaryFile() as output_file:
+                subprocess.run([self.archiver_executable, "-c", output_file.name, "-"], input=data, check=True)
+                output = subprocess.run([self.archiver_executable, "--stdout", "-d", output_file.name],
+                                        stdout=subprocess.PIPE, check=True).stdout
+                if output != data:
+                    self.fail_test_case(case_name, "decompressed data differs from expected")
+
+            self.succeed_test_case(case_name)
+        except subprocess.CalledProcessError:
+            self.fail_test_case(case_name, "archiver finished with non-zero exit code")
+
 
 if __name__ == "__main__":
     tester = ArchiverTester(archiver_executable=sys.argv[1], test_data_dir=sys.argv[2])